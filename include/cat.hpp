@@ -3,28 +3,59 @@
 #pragma once
 
 #include <data.hpp>
+#include <input.hpp>
+#include <math.hpp>
+#include <sprite.hpp>
 
 #include <SFML/Graphics/Drawable.hpp>
 #include <memory>
 #include <SFML/Graphics.hpp>
 #include <json/json.h>
 
+#include <array>
+#include <functional>
 #include <list>
+#include <optional>
 #include <set>
+#include <vector>
 
 namespace cats
 {
 
+// How the cat is actually drawn: into the window, or into the scene
+// scaled to the window if one could be created
+struct RenderParameters
+{
+    // size of the image the cat is drawn into
+    sf::Vector2u size;
+    // from the coordinates of the cat to the pixels of the image
+    sf::Transform transform;
+    // scale the cat is drawn at, included in the transform
+    float scale = 1.0f;
+};
+
 class ICat : public sf::Drawable
 {
 public:
 
-    // Initilizes the cat
+    // Initilizes the cat to be drawn with the render parameters
     // TODO: replace init method with constructor
-    virtual bool init(const data::Settings& st, const Json::Value& cfg) = 0;
+    virtual bool init(const data::Settings& st, const Json::Value& cfg, const RenderParameters& render) = 0;
+
+    // Updates cat's state according to the input snapshot, called per frame.
+    // Returns true if the cat looks different than after the previous call
+    virtual bool update(const input::InputFrame&) { return false; }
 
-    // Updates cat's state, called per frame
-    virtual void update() {}
+    // Updates only the state depending on the mouse position,
+    // called after the position has been latched again
+    virtual void update_mouse(const input::InputFrame&) {}
+
+    // Resolves the key bindings again after the keyboard mapping has changed
+    virtual void resolve_keys() {}
+
+    // Returns true if drawing the cat overwrites the whole target,
+    // which then does not have to be cleared
+    virtual bool is_covering_target() const { return false; }
 
     // Virtual destructor
     virtual ~ICat() {}
@@ -37,19 +68,124 @@ protected:
     // Initialize mouse paw with json config
     bool init(const Json::Value& mouse_cfg, const Json::Value& paw_cfg);
 
-    // Update device and paw position according to the mouse_pos
-    void update_paw_position(std::pair<double, double> mouse_pos);
+    // Update device and paw position according to the mouse_pos,
+    // returns false if the position is the same as the previous one
+    bool update_paw_position(std::pair<double, double> mouse_pos);
 
-    // Display paw represented by its coordinates pss2
+    // Display paw geometry built by update_paw_position
     void draw_paw(sf::RenderTarget& target, sf::RenderStates rst) const;
 
     // Set offset and scale for mouse sprite
     void set_mouse_parameters(sf::Vector2i offset, double scale);
 
-    std::unique_ptr<sf::Sprite> device, left_button, right_button;
+    // Set the scale the cat is drawn at on the screen,
+    // the paw outline gets more points when it is drawn larger
+    void set_render_scale(float scale);
+
+    // Set the memory in bytes the paw poses may be precomputed into by init,
+    // the poses are computed every frame if it is 0
+    void set_pose_cache_size(std::size_t size);
+
+    std::unique_ptr<AtlasSprite> device, left_button, right_button;
 private:
-    // draw an arc about an array of points
-    void draw_arc(sf::RenderTarget& target, sf::RenderStates rst, sf::Color color, float width) const;
+    // number of points sampled on every segment of the paw arc
+    static constexpr int arc_segment_samples = 6;
+    // number of control points of the whole paw arc
+    static constexpr std::size_t arc_points = 3 * arc_segment_samples + 1;
+    // largest number of pieces a span between two control points is split into
+    static constexpr std::size_t max_span_pieces = 8;
+    // largest number of points the paw outline is tessellated into
+    static constexpr std::size_t max_paw_points = (arc_points - 1) * max_span_pieces + 1;
+    // largest distance in pixels between the tessellated outline and the spline
+    static constexpr float outline_tolerance = 0.25f;
+    // difference between the widths of an arc at its start and its end
+    static constexpr float arc_taper = 2.0f;
+    // number of triangles a round cap at an end of an arc is made of
+    static constexpr std::size_t cap_segments = 16;
+    // largest number of vertices of the body, the shadow and the line of the arm
+    static constexpr std::size_t max_paw_vertices = 3 * (max_paw_points - 2)
+        + 2 * (6 * (max_paw_points - 1) + 2 * 3 * cap_segments);
+    // largest number of poses along a side of the pose cache grid
+    static constexpr std::size_t max_pose_grid_size = 128;
+
+    // A stroke along the paw outline with round caps at its ends
+    struct Arc
+    {
+        sf::Color color;
+        // width of the stroke at its start, it narrows towards the end
+        float width = 0;
+    };
+
+    // The paw geometry is rebuilt in place every frame,
+    // all the memory is allocated once along with the paw
+    struct Geometry
+    {
+        std::array<sf::Vector2f, arc_points> arc_control_points;
+        std::array<sf::Vector2f, max_paw_points> pss2;
+        // spline parameters of the outline points, from 0 to 1
+        std::array<float, max_paw_points> pss2_params;
+        std::size_t paw_point_count = 0;
+        // unit directions along the outline, shared by all the arcs
+        std::array<float, max_paw_points> direction_x, direction_y;
+
+        // all the paw's triangles, drawn at once
+        std::array<sf::Vertex, max_paw_vertices> vertices;
+        std::size_t vertex_count = 0;
+
+        // position of the mouse sprite
+        sf::Vector2f device_position;
+    };
+
+    // Paw poses precomputed on a grid of mouse positions over the unit square.
+    // All the poses have the same vertices, only their positions are stored
+    struct PoseCache
+    {
+        // number of poses along a side of the grid, 0 if there is no cache
+        std::size_t grid_size = 0;
+        std::size_t vertex_count = 0;
+        // vertex positions of the poses, row by row
+        std::vector<sf::Vector2f> positions;
+        std::vector<sf::Vector2f> device_positions;
+    };
+
+    // build the paw for the mouse position; a zero tolerance
+    // splits every span of the outline into max_span_pieces
+    void build_pose(std::pair<double, double> mouse_pos, float tolerance, Geometry& g) const;
+
+    // build the triangles of the whole paw from the outline points
+    void build_geometry(Geometry& g) const;
+
+    // append the triangles of an arc about the paw outline points
+    void add_arc(Geometry& g, const Arc& arc) const;
+
+    // append the triangles of a round cap
+    void add_cap(Geometry& g, sf::Vector2f center, float radius, sf::Color color) const;
+
+    // precompute the poses in parallel, as many as fit into the cache size
+    void build_pose_cache();
+
+    // blend the positions of the cached poses around the mouse position
+    void blend_pose(std::pair<double, double> mouse_pos, Geometry& g) const;
+
+    // curves the paw outline is built of; the segments are sampled
+    // to get the points the outline spline passes through
+    using SegmentCurve2 = math::SampledBCurve<2, arc_segment_samples>;
+    using SegmentCurve3 = math::SampledBCurve<3, arc_segment_samples>;
+
+    Geometry geometry;
+    // unit vectors from the center of a cap to its boundary
+    std::array<sf::Vector2f, cap_segments + 1> cap_directions;
+    Arc shadow, edge;
+
+    // the triangles are uploaded into the video memory only when the paw has moved,
+    // they are drawn from the geometry if there are no vertex buffers
+    sf::VertexBuffer paw_buffer{sf::PrimitiveType::Triangles, sf::VertexBuffer::Usage::Stream};
+    bool is_paw_buffered = false;
+
+    std::size_t pose_cache_size = 0;
+    PoseCache pose_cache;
+
+    float render_scale = 1.0f;
 
     double scale = 1.0;
     sf::Vector2i offset = {0, 0};
@@ -60,55 +196,108 @@ private:
 
     sf::Color paw_color;
     sf::Color paw_edge_color;
-    std::vector<sf::Vector2f> pss2;
+
+    // mouse position the paw has been computed for
+    std::optional<std::pair<double, double>> paw_mouse_pos;
 };
 
-class CatKeyboardGroup : public sf::Drawable {
+class CatKeyboardGroup {
 public:
-    void init(const Json::Value& keys_config);
+    void init(const Json::Value& keys_config, int min_press_frames = 1);
 
-    void update();
-    
-    void draw(sf::RenderTarget& target, sf::RenderStates rst) const override;
+    // Returns true if the drawn bindings have changed
+    bool update(const input::InputFrame& frame);
+
+    // Appends the images of the drawn bindings to the queue
+    void add_to(SpriteQueue& queue) const;
+
+    // Resolves the key codes of the bindings into the current keycodes
+    void resolve_keys();
 
 private:
     class Key {
     public:
-        Key(int i, bool p, bool j)
-            : id(i), persistent(p), is_joystick(j) {}
+        Key(int i, bool p)
+            : id(i), persistent(p) {}
+
+        void add_keys(const std::vector<input::KeyMask>& masks) {
+            key_masks.insert(key_masks.end(), masks.begin(), masks.end());
+        }
 
-        void add_codes(std::set<int> cds) {
-            codes.merge(cds);
+        void set_keys(const std::vector<input::KeyMask>& masks) {
+            key_masks = masks;
+        }
+
+        void add_joystick_codes(const input::JoystickMask& codes) {
+            joystick_codes |= codes;
         }
 
         int get_id() const {
             return id; 
         }
 
-        bool is_pressed() const;
+        bool is_pressed(const input::InputFrame& frame) const;
+
+        // Updates the state of the key according to the input snapshot
+        void update(const input::InputFrame& frame, int min_press_frames);
+
+        // Returns true if the key is to be displayed as pressed
+        bool is_active() const {
+            return active;
+        }
+
+        // Returns true if the key has been pressed since the previous frame
+        bool is_new_press() const {
+            return new_press;
+        }
+
+        // Position of the key's latest press among the frame's key presses
+        int get_press_order() const {
+            return press_order;
+        }
 
         bool is_persistent() const {
             return persistent;
         }
 
         bool is_combined() const {
-            return codes.size() > 1;
+            return key_masks.size() + joystick_codes.count() > 1;
+        }
+
+        bool is_empty() const {
+            return key_masks.empty() && joystick_codes.none();
         }
 
     private:
+        int find_press_order(const input::InputFrame& frame) const;
+
         int id;
         bool persistent;
-        bool is_joystick;
-        std::set<int> codes;
+        // every key of a combination is resolved into a set of keycodes
+        std::vector<input::KeyMask> key_masks;
+        input::JoystickMask joystick_codes;
+
+        bool active = false;
+        bool new_press = false;
+        int press_order = -1;
+        // number of frames the key is still displayed for after a press
+        int frames_left = 0;
     };
 
+    int min_press_frames = 1;
+
     std::list<Key> released_keys;
     std::list<Key> combined_keys;
     std::list<Key> pressed_keys;
     std::list<Key> persistent_keys;
-    std::unique_ptr<sf::Drawable> def_kbg;
-    std::vector<std::unique_ptr<sf::Drawable>> sprites;
-    std::map<int, sf::Drawable*> key_actions;
+    // images of a binding, drawn over each other
+    using Images = std::vector<data::TextureRegion>;
+    Images default_images;
+    std::vector<Images> images;
+    // index of the images of every key
+    std::map<int, std::size_t> key_actions;
+    // key codes of every key as configured, resolved again when the mapping changes
+    std::map<int, Json::Value> key_codes;
 };
 
 class CatKeyboardGroup;
@@ -117,19 +306,87 @@ class CustomCat : public ICat, private MousePaw
 {
 public:
 
-    bool init(const data::Settings& st, const Json::Value& cfg) override;
-    void update() override;
+    bool init(const data::Settings& st, const Json::Value& cfg, const RenderParameters& render) override;
+    bool update(const input::InputFrame& frame) override;
+    void update_mouse(const input::InputFrame& frame) override;
     void draw(sf::RenderTarget& target, sf::RenderStates rst) const override;
+    void resolve_keys() override;
+    bool is_covering_target() const override { return static_layers.has_value(); }
 
 private:
     bool init_mouse(const Json::Value& mouse_config);
 
+    // list the layers of the cat from the bottom one
+    void build_layers();
+
+    // rebuild the batches of the sprites which stay in place
+    void update_batches();
+
+    // rebuild the batches of the sprites which move along with the paw
+    void update_moving_batches();
+
+    // render the layers which do not change over the background color
+    // into a texture the size of the target
+    void render_static_layers(sf::Vector2u size, const sf::Transform& transform, sf::Color color);
+
 private:
 
-    std::unique_ptr<sf::Sprite> bg;
+    data::TextureRegion bg;
     std::list<std::unique_ptr<CatKeyboardGroup>> kbd_groups;
 
+    // A layer of the cat; the layers are listed once, the sprites
+    // they show are collected again whenever the cat changes
+    struct Layer
+    {
+        enum class Kind
+        {
+            // sprites staying in place
+            Still,
+            // sprites moving along with the paw
+            Moving,
+            // the paw is drawn by itself, no sprite is moved across it
+            Paw
+        };
+
+        // appends the sprites the layer shows at the moment
+        std::function<void(SpriteQueue&)> add_sprites;
+        Kind kind = Kind::Still;
+    };
+    std::vector<Layer> layers;
+
+    // Consecutive layers of the same kind, drawn at once. The still sprites
+    // are batched only when the bindings change, the few moving ones are
+    // batched apart from them every time the paw moves
+    struct Pass
+    {
+        Pass(Layer::Kind kind, std::size_t layer, std::size_t group)
+            : kind(kind)
+            , first_layer(layer)
+            , last_layer(layer + 1)
+            , group(group)
+            , batch(kind == Layer::Kind::Moving ? sf::VertexBuffer::Usage::Stream
+                                                : sf::VertexBuffer::Usage::Static) {}
+
+        Layer::Kind kind;
+        std::size_t first_layer, last_layer;
+        // group of the sprite queue a batch of still sprites is built from
+        std::size_t group;
+        SpriteBatch batch;
+    };
+    std::vector<Pass> passes;
+
+    SpriteQueue sprite_queue, moving_queue;
+    // the sprites drawn have changed since the batches were built
+    bool is_batch_dirty = true;
+    bool is_moving_batch_dirty = true;
+
+    // the layers which do not change, if they are cached; otherwise
+    // the background is drawn along with the back batch
+    std::optional<sf::RenderTexture> static_layers;
+
     bool is_mouse, is_mouse_on_top;
+    bool is_left_button_pressed = false;
+    bool is_right_button_pressed = false;
 };
 
 }
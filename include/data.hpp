@@ -1,13 +1,37 @@
+#pragma once
+
 #include <json/json.h>
 #include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/Graphics/Texture.hpp>
 #include <SFML/Graphics/Transform.hpp>
 
+#include <cstddef>
 #include <optional>
 #include <stdexcept>
 #include <fstream>
 
 namespace data {
 
+// The part of a texture an image occupies. The transparent border of the image
+// is trimmed off, offset is the position of the region in the original image
+struct TextureRegion
+{
+    const sf::Texture* texture = nullptr;
+    sf::IntRect rect;
+    sf::Vector2f offset;
+    // every pixel of the region is fully opaque
+    bool is_opaque = false;
+    // the image is stored resampled by this scale along each axis; the size of
+    // the resampled image is rounded, so it is not exactly the scale asked for
+    sf::Vector2f scale = {1.0f, 1.0f};
+
+    // size of the region in the pixels of the original image
+    sf::Vector2f get_size() const {
+        return sf::Vector2f(rect.size).componentWiseDiv(scale);
+    }
+};
+
 class ConfigFile {
 public:
     bool init(int argc, char ** argv);
@@ -15,9 +39,17 @@ public:
     std::ifstream& load_config_file();
     std::string get_config_name() const;
 
+    // input recording options of the command line
+    const std::optional<std::string>& get_record_path() const { return record_path; }
+    const std::optional<std::string>& get_replay_path() const { return replay_path; }
+    bool is_replay_unpaced() const { return replay_unpaced; }
+
 private:
     std::ifstream cfg_file;
     std::string conf_file_path;
+    std::optional<std::string> record_path;
+    std::optional<std::string> replay_path;
+    bool replay_unpaced = false;
 };
 
 class Settings {
@@ -27,10 +59,32 @@ public:
     // window settings
     sf::Vector2u get_window_size() const;
     sf::Transform get_window_transform() const;
+    // scale the cat is drawn at, included in the window transform
+    float get_window_scale() const;
+    // size of the image the cat is rendered into before it is scaled to the window,
+    // the window size itself if the cat is rendered directly
+    sf::Vector2u get_render_size() const;
+    // the window transform and scale for rendering into an image of the render size
+    sf::Transform get_render_transform() const;
+    float get_render_scale() const;
+    bool is_render_on_change() const;
+    // target frame rate in Hz, timing::FramePacer::VSYNC if paced by vsync
+    int get_frame_rate() const;
+    // memory in bytes the paw poses may be precomputed into, 0 if they are not
+    std::size_t get_paw_cache_size() const;
+    // the layers which do not change are drawn once into a render texture
+    bool is_layer_cache_enabled() const;
 
     // global mouse settings
     bool is_mouse_left_handed() const;
 
+    // global input settings
+    int get_min_press_frames() const;
+    int get_input_sampling_rate() const;
+    std::string get_input_monitor() const;
+    std::string get_input_backend() const;
+    bool is_mouse_late_latched() const;
+
     // global decoration settings
     sf::Color get_background_color() const;
 
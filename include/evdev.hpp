@@ -0,0 +1,105 @@
+// Keyboards and mice read directly from the kernel's evdev interface
+
+#pragma once
+
+#include <sync.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define EVDEV_DIR "/dev/input"
+#define EVDEV_QUEUE_SIZE 4096
+
+namespace input
+{
+
+class IKeyboard;
+
+// An event of a device as passed from the reader thread
+struct EvdevEvent
+{
+    uint16_t type;
+    uint16_t code;
+    int32_t value;
+    // kernel timestamp in milliseconds of the monotonic clock
+    uint64_t time;
+};
+
+// Reads keyboards and mice on a dedicated thread and passes their
+// events to a single consumer through a lock-free queue
+class EvdevReader
+{
+public:
+
+    // Reads the keyboards and mice among the event nodes of the directory
+    explicit EvdevReader(const std::string& dir = EVDEV_DIR);
+
+    // Reads the given non-blocking file descriptors as devices and closes them
+    // when done; anything producing input_event structs will do, e.g. a uinput
+    // device or a pipe replaying recorded events
+    explicit EvdevReader(const std::vector<int>& device_fds);
+
+    ~EvdevReader();
+
+    // Returns false if no device could be opened
+    bool is_open() const {
+        return device_count.load(std::memory_order_relaxed) > 0;
+    }
+
+    // Returns the number of devices which are read, the unplugged ones are dropped
+    std::size_t get_device_count() const {
+        return device_count.load(std::memory_order_relaxed);
+    }
+
+    // Takes the oldest event, returns false if there are none; never blocks
+    bool pop(EvdevEvent& evt) {
+        return events.pop(evt);
+    }
+
+    // Returns true if events have been dropped since the previous call
+    bool take_overflow() {
+        return is_overflowed.exchange(false, std::memory_order_relaxed);
+    }
+
+private:
+    struct Device
+    {
+        int fd;
+        // the kernel has dropped events of the device, the rest of
+        // its events are skipped up to the next report
+        bool is_dropped = false;
+    };
+
+    bool init_polling();
+    void open_devices(const std::string& dir);
+    bool add_device(int fd);
+    void start();
+    void run();
+    void read_device(Device& device);
+    void close_device(int fd);
+    void resync_keys(uint64_t time);
+    void push(const EvdevEvent& evt);
+
+    std::vector<Device> devices;
+    std::atomic<std::size_t> device_count{0};
+    int epoll_fd = -1;
+    // wakes the reader thread up on shutdown
+    int stop_fd = -1;
+
+    lockfree::SpscQueue<EvdevEvent, EVDEV_QUEUE_SIZE> events;
+    std::atomic<bool> is_overflowed{false};
+    // events have been pushed since the consumer was notified, reader thread only
+    bool has_pushed = false;
+    std::thread thread;
+};
+
+// Creates a keyboard reading the devices of the reader, the pointer
+// motion is reported through the mouse created for the keyboard
+std::unique_ptr<IKeyboard> create_evdev_keyboard_handler(std::unique_ptr<EvdevReader> reader);
+
+}
@@ -1,6 +1,7 @@
 #pragma once
-#define MAX_FRAMERATE 60
 
+#include <chrono>
+#include <optional>
 #include <string>
 #include <vector>
 #include <set>
@@ -12,25 +13,99 @@ namespace data {
 
 extern const sf::Vector2u g_window_default_size;
 
-std::set<int> json_key_to_scancodes(const Json::Value& key_array, bool is_joystick);
+std::vector<input::KeyMask> json_key_to_keymasks(const Json::Value& key_array);
+input::JoystickMask json_joy_key_to_mask(const Json::Value& key_array);
 bool is_intersection(const std::vector<std::set<int>>& sets);
 
 bool init();
 sf::Texture &load_texture(std::string path);
+// Sets the scale the images are resampled to when they are packed,
+// that is the scale they are drawn at on the window
+void set_texture_scale(float scale);
+// Packs the images which are not packed yet into atlas textures, as few as
+// possible, so that sprites showing them can be drawn at once. Every group
+// lists images which are always drawn over each other, in the order they are
+// drawn; if it looks the same, a group is composited into a single image
+void pack_textures(const std::vector<std::vector<std::string>>& groups);
+// Returns the region of an atlas the image is packed into; the whole
+// texture of the image if it has not been packed
+TextureRegion load_texture_region(const std::string& path);
+// Returns the regions to draw a group of images with, a single one if
+// the group has been composited
+std::vector<TextureRegion> load_texture_regions(const std::vector<std::string>& paths);
 sf::Font &get_debug_font();
 }; // namespace data
 
 namespace input {
+// Makes Xlib safe for use from several threads,
+// must be called before any window is created
+void init_threads();
+
 bool init(int width, int height, bool is_left_handed = false);
 
-bool is_pressed(int key_code);
+// Sample input devices on a separate thread at the given rate in Hz,
+// zero rate makes the devices sampled on the render thread
+void set_sampling_rate(int rate);
+
+// Select the source of keyboard and mouse input: "x11" or "evdev",
+// which reads /dev/input directly and falls back to x11 if it is not readable
+void set_backend(const std::string& backend);
+
+// Map the mouse position onto the given monitor; an XRandR output
+// name, "primary" or an index counting from the left, empty for the whole desktop
+void set_monitor(const std::string& monitor);
+
+// Make the pointer motion wake wait_for_input up; only the frames
+// rendered on change wait for input, otherwise the events are not read
+void set_motion_waking(bool is_waking);
+
+// Process pending input events and update the snapshot
+// of the input devices' state, called once per frame
+void capture_frame(InputFrame& frame);
+
+// Sample the mouse position of the frame again, as late as possible
+// before the frame is drawn; the rest of the frame is left intact
+void latch_mouse(InputFrame& frame);
+
+// Blocks until input events are pending on the input display connection,
+// the sampler or the evdev reader has got new input, or the timeout expires;
+// input which is not delivered as events is noticed only when the timeout expires
+void wait_for_input(std::chrono::microseconds timeout);
+
+// Write every captured frame into a file
+bool start_recording(const std::string& path);
+
+// Replace the input devices with a recording; a paced replay follows
+// the recorded timing, otherwise a recorded frame is replayed every frame
+bool start_replay(const std::string& path, bool is_paced);
+
+// Returns true once the replay has reached the end of the recording
+bool is_replay_finished();
+
+// Resolve a config key code into the set of X keycodes producing it. Virtual
+// key codes of the original config format are translated into keysyms first,
+// other values are treated as keysyms
+KeyMask resolve_key_code(int key_code);
+
+// Resolve an X keysym name, e.g. "KP_Decimal", into the set of X keycodes
+std::optional<KeyMask> resolve_key_name(const std::string& name);
+
+// Returns true if the keyboard mapping has changed since the previous call,
+// e.g. by setxkbmap or a keyboard with another layout plugged in; the key
+// codes are then to be resolved again
+bool take_keymap_change();
+
+// Returns true if any of the keycodes of the key
+// has been pressed since the previous frame
+bool is_pressed(const InputFrame& frame, const KeyMask& key);
 
 bool is_joystick_connected();
-bool is_joystick_pressed(int key_code);
 
-IMouse& get_mouse_input();
+// Returns true if all of the joystick codes are pressed
+bool is_joystick_pressed(const InputFrame& frame, const JoystickMask& codes);
 
-void drawDebugPanel(sf::RenderWindow& window);
+// Draws the state of the input devices below the given frame information
+void drawDebugPanel(sf::RenderWindow& window, const InputFrame& frame, const std::string& frame_info);
 
 void cleanup(); // TODO: use RAII here
 }; // namespace input
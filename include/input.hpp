@@ -2,11 +2,64 @@
 
 #pragma once
 
+#include <bitset>
+#include <chrono>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace input
 {
 
+// Set of X keycodes indexed by keycode values
+using KeyMask = std::bitset<256>;
+
+// Set of joystick buttons and axis directions indexed by joystick codes
+using JoystickMask = std::bitset<64>;
+
+// A key press registered by the keyboard handler
+struct KeyStroke
+{
+    // X keycode of the pressed key
+    unsigned int keycode;
+
+    // time of the press in milliseconds
+    unsigned long time;
+};
+
+// Snapshot of all input devices' state, captured once per frame
+struct InputFrame
+{
+    // keys which are held down at the moment of capturing
+    KeyMask keys;
+
+    // keys which have been held down at any moment since the previous
+    // frame, including short taps which have already been released
+    KeyMask latched_keys;
+
+    // key presses since the previous frame in the order they happened
+    std::vector<KeyStroke> key_presses;
+
+    // pressed joystick buttons and axis directions
+    JoystickMask joystick;
+
+    // mouse position in the unit square [0,1]x[0,1]
+    std::pair<double, double> mouse_pos = {0.0, 0.0};
+
+    bool is_left_button_pressed = false;
+    bool is_right_button_pressed = false;
+
+    // time the devices' state has been sampled at
+    std::chrono::steady_clock::time_point sample_time;
+
+    // time the mouse position has been sampled at; it is later
+    // than sample_time if the position has been latched again
+    std::chrono::steady_clock::time_point mouse_time;
+
+    // number of requests sent to the X server since the previous frame
+    unsigned long x_requests = 0;
+};
+
 class IMouse
 {
 public:
@@ -24,7 +77,44 @@ public:
     virtual ~IMouse() {};
 };
 
+class IKeyboard
+{
+public:
+
+    // Updates the state of keys and buttons, called once per frame
+    virtual void update() = 0;
+
+    // Returns true if a key with the given X keycode is pressed
+    virtual bool is_key_pressed(unsigned int keycode) const = 0;
+
+    // Returns true if a mouse button with the given X button number is pressed
+    virtual bool is_button_pressed(unsigned int button) const = 0;
+
+    // Returns the state of all keys indexed by X keycodes
+    virtual const KeyMask& get_keys() const = 0;
+
+    // Moves the key presses registered since the previous call into presses
+    virtual void take_key_presses(std::vector<KeyStroke>& presses) = 0;
+
+    virtual ~IKeyboard() {};
+};
+
+
+// The raw pointer motion is selected only if it is to wake the render loop up
+std::unique_ptr<IKeyboard> create_keyboard_handler(void* display, bool is_motion_selected = false);
+// The mouse position is mapped onto the given monitor, see ScreenLayout
+std::unique_ptr<IMouse> create_mouse_handler(void* display, IKeyboard& keyboard, bool is_left_handed,
+                                             const std::string& monitor = "");
+
+// Handlers reading the kernel input devices directly; the keyboard handler
+// is null if no device is readable, the mouse handler requires the evdev keyboard
+// and maps the mouse onto the whole desktop if the display is null
+std::unique_ptr<IKeyboard> create_evdev_keyboard_handler();
+std::unique_ptr<IMouse> create_evdev_mouse_handler(void* display, IKeyboard& keyboard, bool is_left_handed,
+                                                   const std::string& monitor = "");
 
-std::unique_ptr<IMouse> create_mouse_handler(void* display, bool is_left_handed);
+// Wakes up wait_for_input, called by the threads reading the input devices
+// when new input has arrived; safe to call from any thread
+void notify_input();
 
 }
@@ -1,7 +1,10 @@
 // Math helpers
 #pragma once
 
-#include <vector>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
 #include <stdint.h>
 #include <SFML/System/Vector2.hpp>
 
@@ -10,34 +13,175 @@ namespace math
 
 using point2d = sf::Vector2<double>;
 
-// Bezier curve
-class BCurve {
+// Scales the vectors given by their coordinates to unit length in place,
+// a vector of zero length gets NaN coordinates
+void normalize(float* xs, float* ys, std::size_t count);
+
+namespace detail
+{
+
+// computes a binomial coefficient B(n, k) at compile time
+constexpr uint64_t binomial_coefficient(uint32_t n, uint32_t k) {
+    if (k > n)
+        return 0;
+
+    k = k < n - k ? k : n - k;
+    uint64_t c = 1;
+    for (uint32_t i = 0; i < k; ++i)
+        c = c * (n - i) / (i + 1);
+    return c;
+}
+
+}
+
+// Bezier curve of a fixed order, which is evaluated at the fixed parameter
+// values t = i / Samples, i = 0..Samples. The Bernstein polynomials are
+// tabulated at compile time, so evaluating the curve at all the samples is
+// a product of the basis matrix and the control points. The loops run over
+// contiguous arrays of T and are vectorized by the compiler
+template<std::size_t Order, std::size_t Samples, typename T = double>
+class SampledBCurve {
+public:
+
+    using point = sf::Vector2<T>;
+    using control_points = std::array<point, Order + 1>;
+    using sample_points = std::array<point, Samples + 1>;
+
+    // evaluates the curve at all the samples; result[i] is the point for t = i / Samples
+    static void evaluate(const control_points& p, sample_points& result) {
+        std::array<T, Samples + 1> xs = {}, ys = {};
+
+        for (std::size_t k = 0; k <= Order; ++k) {
+            const T px = p[k].x, py = p[k].y;
+            const auto& row = basis[k];
+            for (std::size_t i = 0; i <= Samples; ++i) {
+                xs[i] += row[i] * px;
+                ys[i] += row[i] * py;
+            }
+        }
+
+        for (std::size_t i = 0; i <= Samples; ++i)
+            result[i] = point(xs[i], ys[i]);
+    }
+
+private:
+    using basis_matrix = std::array<std::array<T, Samples + 1>, Order + 1>;
+
+    // basis[k][i] is the k-th Bernstein polynomial at t = i / Samples
+    static constexpr basis_matrix compute_basis() {
+        basis_matrix b = {};
+        for (std::size_t i = 0; i <= Samples; ++i) {
+            const double t = double(i) / Samples;
+            for (std::size_t k = 0; k <= Order; ++k) {
+                double value = detail::binomial_coefficient(Order, k);
+                for (std::size_t j = 0; j < k; ++j)
+                    value *= t;
+                for (std::size_t j = k; j < Order; ++j)
+                    value *= 1.0 - t;
+                b[k][i] = T(value);
+            }
+        }
+        return b;
+    }
+
+    static constexpr basis_matrix basis = compute_basis();
+};
+
+// Centripetal Catmull-Rom spline through a sequence of points. Unlike a Bezier
+// curve over the same points it passes through every one of them and each
+// span depends on its four nearest points only, so it stays well conditioned
+// for any number of points and has no cusps or self-intersections within a span
+template<typename T>
+class CatmullRomSpline {
 public:
 
-    // constructs a Bezier curve of the specific order
-    BCurve(uint32_t order);
+    using point = sf::Vector2<T>;
+
+    // The points are not copied and have to outlive the spline;
+    // at least two points are required
+    CatmullRomSpline(const point* p, std::size_t count)
+        : points(p), point_count(count) {}
+
+    std::size_t get_span_count() const {
+        return point_count - 1;
+    }
+
+    // evaluates the span between points[span] and points[span + 1], 0 <= t <= 1
+    point operator()(std::size_t span, T t) const {
+        // the ends are extended by mirroring the neighbouring points
+        const point p1 = points[span];
+        const point p2 = points[span + 1];
+        const point p0 = span > 0 ? points[span - 1] : p1 * T(2) - p2;
+        const point p3 = span + 2 < point_count ? points[span + 2] : p2 * T(2) - p1;
+
+        // centripetal parametrization: the knot intervals are
+        // the square roots of the distances between the points
+        const T d0 = knot_interval(p0, p1);
+        const T d1 = knot_interval(p1, p2);
+        const T d2 = knot_interval(p2, p3);
+
+        // Barry and Goldman's pyramidal formulation for the knots 0, d0, d0 + d1, d0 + d1 + d2
+        const T t0 = 0, t1 = d0, t2 = d0 + d1, t3 = d0 + d1 + d2;
+        const T u = t1 + t * d1;
+
+        const point a1 = p0 * ((t1 - u) / d0) + p1 * ((u - t0) / d0);
+        const point a2 = p1 * ((t2 - u) / d1) + p2 * ((u - t1) / d1);
+        const point a3 = p2 * ((t3 - u) / d2) + p3 * ((u - t2) / d2);
+        const point b1 = a1 * ((t2 - u) / (t2 - t0)) + a2 * ((u - t0) / (t2 - t0));
+        const point b2 = a2 * ((t3 - u) / (t3 - t1)) + a3 * ((u - t1) / (t3 - t1));
+        return b1 * ((t2 - u) / d1) + b2 * ((u - t1) / d1);
+    }
+
+    // Tessellates the spline into a polyline which deviates from the spline by about
+    // tolerance. The deviation is measured after multiplying the coordinates by scale,
+    // so a spline drawn larger on the screen gets more points. Every span is split
+    // into at most max_pieces pieces; params receives the spline parameter of every
+    // point, from 0 at the first point to 1 at the last one. A zero tolerance splits
+    // every span into max_pieces. Returns the number of points written, which is
+    // at most get_span_count() * max_pieces + 1
+    std::size_t tessellate(T tolerance, T scale, std::size_t max_pieces, point* result, T* params) const {
+        const std::size_t spans = get_span_count();
+        std::size_t n = 0;
 
-    // evaluates bezier point for a parameter value t, 0 <= t <= 1
-    point2d operator()(double t) const;
+        for (std::size_t span = 0; span < spans; ++span) {
+            const std::size_t pieces = count_pieces(span, tolerance, scale, max_pieces);
+            for (std::size_t i = 0; i < pieces; ++i) {
+                const T t = T(i) / pieces;
+                result[n] = i == 0 ? points[span] : (*this)(span, t);
+                params[n] = (span + t) / spans;
+                ++n;
+            }
+        }
 
-    // sets the array of control points for the curve
-    void set_control_points(const std::vector<point2d>& p);
+        result[n] = points[spans];
+        params[n] = T(1);
+        return n + 1;
+    }
 
 private:
-    // computes an array of binomial coefficients of the order n
-    std::vector<uint64_t> compute_coefficients(uint32_t n) const;
+    static T knot_interval(const point& a, const point& b) {
+        // coincident points would make the knots degenerate
+        const T distance = std::hypot(b.x - a.x, b.y - a.y);
+        return std::max(std::sqrt(distance), T(1e-4));
+    }
 
-    // computes a binomial coefficient B(n, k)
-    uint64_t binomial_coefficient(uint32_t n, uint32_t k) const;
+    // Estimates the number of pieces the span is split into. The deviation
+    // of a chord from a smooth curve falls with the square of the number of
+    // pieces, so it is estimated from the deviation at the span's middle
+    std::size_t count_pieces(std::size_t span, T tolerance, T scale, std::size_t max_pieces) const {
+        if (tolerance <= 0)
+            return max_pieces;
 
-    // computes the value of the Bernstein polynomial for a parameter t
-    double basis_polynomial(uint32_t k, double t) const;
+        const point middle = (*this)(span, T(0.5));
+        const point chord_middle = (points[span] + points[span + 1]) / T(2);
+        const T deviation = std::hypot(middle.x - chord_middle.x, middle.y - chord_middle.y) * scale;
 
-    // binomial coefficients
-    const std::vector<uint64_t> b_coeff;
+        const T pieces = std::ceil(std::sqrt(deviation / tolerance));
+        return std::clamp<std::size_t>(pieces, 1, max_pieces);
+    }
 
-    // set of control points of the curve
-    std::vector<point2d> points;
+    const point* points;
+    std::size_t point_count;
 };
 
 }
@@ -0,0 +1,110 @@
+// Frame pacing
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+#define DEFAULT_FRAME_RATE 60
+#define MIN_FRAME_RATE 30
+#define MAX_FRAME_RATE 240
+
+namespace timing
+{
+
+// Statistics of the intervals between the latest presented frames
+struct FrameStats
+{
+    // average interval between two presents
+    std::chrono::microseconds mean_interval{0};
+
+    // root mean square deviation of the intervals from the target period,
+    // from the average interval if the frames are paced by vsync
+    std::chrono::microseconds jitter{0};
+
+    // largest deviation of an interval
+    std::chrono::microseconds max_jitter{0};
+
+    // number of intervals longer than one and a half periods
+    unsigned int late_frames = 0;
+
+    // number of intervals the statistics are computed over
+    unsigned int frames = 0;
+
+    // average and largest time from sampling the input to presenting it
+    std::chrono::microseconds mean_latency{0};
+    std::chrono::microseconds max_latency{0};
+};
+
+// Presents frames at a fixed rate. The pacer sleeps until shortly before
+// an absolute deadline and spins for the rest, so frames are neither
+// repeated nor skipped due to the coarse granularity of sleeping
+class FramePacer
+{
+public:
+
+    using clock = std::chrono::steady_clock;
+
+    // special values of the target rate
+    static constexpr int VSYNC = 0;
+    static constexpr int UNLIMITED = -1;
+
+    FramePacer();
+
+    // Sets the target rate in Hz, which is clamped to the supported range,
+    // VSYNC leaves the pacing to the driver, UNLIMITED disables it
+    void set_rate(int rate);
+
+    int get_rate() const {
+        return rate;
+    }
+
+    bool is_vsync() const {
+        return rate == VSYNC;
+    }
+
+    // Returns the target frame period; the default one if there is no target rate
+    clock::duration get_period() const {
+        return period;
+    }
+
+    // Blocks until the deadline of the next frame, called right before
+    // presenting or, if the input is latched late, before drawing
+    void wait();
+
+    // Records the moment a frame has been presented,
+    // the frame shows the input sampled at input_time
+    void frame_presented(clock::time_point input_time);
+
+    // Called instead of presenting when a frame is skipped on purpose,
+    // so the gap is not taken for jitter
+    void pause();
+
+    FrameStats get_stats() const;
+
+private:
+    // number of intervals the statistics are computed over
+    static constexpr std::size_t history_size = 128;
+
+    int rate = DEFAULT_FRAME_RATE;
+    clock::duration period;
+    clock::time_point deadline;
+
+    // time which is spun away before the deadline instead of sleeping,
+    // adapted to how late the wakeups are
+    clock::duration spin_time;
+
+    bool has_last_present = false;
+    clock::time_point last_present;
+
+    std::array<clock::duration, history_size> intervals = {};
+    std::size_t interval_count = 0;
+    std::size_t next_interval = 0;
+
+    std::array<clock::duration, history_size> latencies = {};
+    std::size_t latency_count = 0;
+    std::size_t next_latency = 0;
+};
+
+}
@@ -0,0 +1,57 @@
+// Recording and replaying the input stream
+
+#pragma once
+
+#include <input.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+namespace input
+{
+
+// Writes input frames into a compact binary file; every record holds
+// the frame's time and only the parts of the state which have changed
+class InputRecorder
+{
+public:
+
+    bool open(const std::string& path);
+
+    void write(const InputFrame& frame);
+
+private:
+    std::ofstream file;
+    std::chrono::steady_clock::time_point start_time;
+    bool is_first_frame = true;
+    InputFrame last_frame;
+};
+
+// Reads input frames written by InputRecorder
+class InputPlayer
+{
+public:
+
+    // A paced player follows the recorded timing, otherwise
+    // every call of read returns the next recorded frame
+    bool open(const std::string& path, bool is_paced);
+
+    // Fills the frame with the recorded state,
+    // returns false once the recording is over
+    bool read(InputFrame& frame);
+
+private:
+    bool read_record();
+
+    std::ifstream file;
+    bool is_paced = true;
+    bool has_record = false;
+    std::chrono::steady_clock::time_point start_time;
+
+    // the next record to be replayed
+    std::chrono::microseconds record_time{0};
+    InputFrame record;
+};
+
+}
@@ -0,0 +1,108 @@
+// Sprites drawn in batches
+
+#pragma once
+
+#include <data.hpp>
+
+#include <SFML/Graphics.hpp>
+
+#include <vector>
+
+namespace cats
+{
+
+class SpriteBatch;
+class SpriteQueue;
+
+// A textured rectangle showing a region of a texture, the same as sf::Sprite,
+// which is not drawn on its own but added to a batch along with other sprites
+class AtlasSprite : public sf::Transformable
+{
+public:
+    explicit AtlasSprite(const data::TextureRegion& region)
+        : region(region) {}
+
+    // appends the sprite to the queue, transformed by its own transform
+    void add_to(SpriteQueue& queue) const;
+
+private:
+    data::TextureRegion region;
+};
+
+// Sprites of a frame in the order they are drawn, split into groups with
+// something else drawn in between. Before they are batched, the sprites fully
+// covered by an opaque sprite drawn later are dropped, and the sprites within
+// a group are reordered so that the ones sharing a texture are drawn together,
+// as long as every sprite stays above the sprites it overlaps
+class SpriteQueue
+{
+public:
+    void clear();
+
+    void add(const data::TextureRegion& region, const sf::Transform& transform = sf::Transform::Identity);
+
+    // the sprites added after this call are drawn after everything added before
+    void next_group();
+
+    // drops the covered sprites and reorders the rest, called once the queue is complete
+    void arrange();
+
+    // appends the sprites of a group to the batch in the arranged order
+    void add_group_to(std::size_t group, SpriteBatch& batch) const;
+
+private:
+    struct Item
+    {
+        data::TextureRegion region;
+        sf::Transform transform;
+        // the rectangle the sprite covers, in the coordinates of the cat
+        sf::FloatRect bounds;
+        // the sprite is opaque and covers all of its bounds
+        bool is_occluder;
+        std::size_t group;
+    };
+
+    std::vector<Item> items;
+    // the items being arranged
+    std::vector<Item> arranged;
+    std::size_t group = 0;
+};
+
+// Sprites drawn together, with a draw call per run of sprites sharing a texture,
+// so sprites packed into one atlas are drawn at once. The vertices are kept in
+// the video memory and uploaded again only when the batch is rebuilt
+class SpriteBatch : public sf::Drawable
+{
+public:
+    // a batch rebuilt every few frames is better kept in a Stream buffer
+    explicit SpriteBatch(sf::VertexBuffer::Usage usage = sf::VertexBuffer::Usage::Static)
+        : buffer(sf::PrimitiveType::Triangles, usage) {}
+
+    void clear();
+
+    // appends a rectangle showing the region, the sprites are drawn in the order they are added
+    void add(const data::TextureRegion& region, const sf::Transform& transform = sf::Transform::Identity);
+
+    // uploads the sprites added since clear, called once the batch is complete
+    void upload();
+
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+
+private:
+    // consecutive sprites sharing a texture
+    struct Run
+    {
+        const sf::Texture* texture;
+        std::size_t first;
+        std::size_t count;
+    };
+
+    std::vector<sf::Vertex> vertices;
+    std::vector<Run> runs;
+
+    // the vertices are drawn from the memory if there are no vertex buffers
+    sf::VertexBuffer buffer;
+    bool is_buffered = sf::VertexBuffer::isAvailable();
+};
+
+}
@@ -0,0 +1,90 @@
+// Lock-free primitives for passing data between threads
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace lockfree
+{
+
+// Passes the latest value from a single writer to a single reader.
+// Neither side ever blocks; the reader always gets the most recent
+// complete value, intermediate values may be skipped
+template<typename T>
+class TripleBuffer
+{
+public:
+
+    // Returns the buffer to be filled by the writer
+    T& write_buffer() {
+        return buffers[back];
+    }
+
+    // Makes the write buffer available to the reader. The new write
+    // buffer holds an arbitrary old value and has to be refilled
+    void publish() {
+        back = middle.exchange(back | dirty_flag, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // Fetches the latest published value, returns false if nothing
+    // has been published since the previous call
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & dirty_flag))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    // Returns the value fetched by the reader
+    const T& read_buffer() const {
+        return buffers[front];
+    }
+
+private:
+    static constexpr unsigned int index_mask = 0x3;
+    static constexpr unsigned int dirty_flag = 0x4;
+
+    std::array<T, 3> buffers = {};
+    std::atomic<unsigned int> middle{1};
+    unsigned int back = 0;
+    unsigned int front = 2;
+};
+
+// Bounded queue for a single producer and a single consumer
+template<typename T, std::size_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+
+    // Appends a value, returns false if the queue is full
+    bool push(const T& value) {
+        const std::size_t pos = write_pos.load(std::memory_order_relaxed);
+        if (pos - read_pos.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items[pos & (Capacity - 1)] = value;
+        write_pos.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Takes the oldest value, returns false if the queue is empty
+    bool pop(T& value) {
+        const std::size_t pos = read_pos.load(std::memory_order_relaxed);
+        if (pos == write_pos.load(std::memory_order_acquire))
+            return false;
+        value = items[pos & (Capacity - 1)];
+        read_pos.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> items = {};
+    // keep the positions on separate cache lines
+    alignas(64) std::atomic<std::size_t> write_pos{0};
+    alignas(64) std::atomic<std::size_t> read_pos{0};
+};
+
+}
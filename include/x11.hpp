@@ -0,0 +1,63 @@
+// X11 specific interfaces shared by the input backends
+
+#pragma once
+
+#include <X11/Xlib.h>
+
+#include <string>
+
+namespace input
+{
+
+class IX11EventListener
+{
+public:
+
+    // Handles an event received from the display connection it listens to
+    virtual void process_x11_event(XEvent& evt) = 0;
+
+    virtual ~IX11EventListener() {};
+};
+
+// Rectangle of the screen in root window coordinates
+struct ScreenRect
+{
+    int x = 0, y = 0;
+    unsigned int width = 1, height = 1;
+};
+
+// Caches the geometry of the monitor the mouse position is mapped onto.
+// The monitors are queried once and again only after XRandR reports
+// a change of the configuration, so there are no per-frame requests
+class ScreenLayout : public IX11EventListener
+{
+public:
+
+    // The monitor is either an XRandR output name, e.g. "DP-1", "primary",
+    // or an index of a monitor counting from the left; an empty
+    // name maps the mouse onto the whole desktop
+    ScreenLayout(Display* display, const std::string& monitor);
+    ~ScreenLayout();
+
+    // Returns the rectangle of the selected monitor
+    const ScreenRect& get_rect();
+
+    void process_x11_event(XEvent& evt) override;
+
+private:
+    void query_monitors();
+
+    Display* dpy;
+    std::string monitor_name;
+    int rr_event_base = -1;
+    bool is_changed = true;
+    ScreenRect rect;
+};
+
+// Subscribe a listener on the events of the display connection
+void add_x11_listener(Display* display, IX11EventListener* listener);
+
+// Unsubscribe a listener from the events of the display connection
+void remove_x11_listener(Display* display, IX11EventListener* listener);
+
+}
@@ -1,67 +1,126 @@
 #include "cat.hpp"
 #include "header.hpp"
-#include <SFML/Graphics/Sprite.hpp>
 #include <SFML/System/Vector2.hpp>
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 
 namespace {
 
+// Returns true if any element has been moved
 template<typename T, typename P>
-void move_if(std::list<T>& dst, std::list<T>& src, P condition) {
+bool move_if(std::list<T>& dst, std::list<T>& src, P condition) {
+    bool is_moved = false;
     for( auto it = src.begin(); it != src.end(); ) {
         // store iterator value before increment 
         // since it will point to the other list after splicing
         auto tmp = it++; 
         if(condition(*tmp)) {
             dst.splice(dst.end(), src, tmp);
+            is_moved = true;
         }
     }
+    return is_moved;
 }
 
-class SpriteArray : public sf::Drawable {
-public:
-    void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
-        for (const auto& s : sprites)
-            target.draw(s, states);
-    }
+// Returns the paths in an array of images
+std::vector<std::string> get_image_paths(const Json::Value& images) {
+    std::vector<std::string> paths;
+    for (const auto& image : images)
+        paths.push_back(image.asString());
+    return paths;
+}
+
+// Collects the paths of all the images of a cat, so that they are packed together;
+// the images drawn over each other are collected in groups
+void collect_images(const Json::Value& config, std::vector<std::vector<std::string>>& groups) {
+    auto add_path = [&groups](const Json::Value& path) {
+        if (path.isString())
+            groups.push_back({path.asString()});
+    };
+    auto add_paths = [&groups](const Json::Value& array) {
+        if (array.isArray() && std::all_of(array.begin(), array.end(),
+                                           [](const Json::Value& path) { return path.isString(); }))
+            groups.push_back(get_image_paths(array));
+    };
+    auto add_keyboard = [&](const Json::Value& keyboard) {
+        add_paths(keyboard["defaultImages"]);
+        if (keyboard["keyBindings"].isArray()) {
+            for (const auto& binding : keyboard["keyBindings"])
+                if (binding.isObject())
+                    add_paths(binding["images"]);
+        }
+    };
+
+    add_path(config["background"]);
 
-    void add(sf::Sprite sprite) {
-        sprites.push_back(sprite);
+    const Json::Value& keyboard = config["keyboard"];
+    if (keyboard.isArray()) {
+        for (const auto& section : keyboard)
+            if (section.isObject())
+                add_keyboard(section);
+    }
+    else if (keyboard.isObject()) {
+        add_keyboard(keyboard);
     }
 
-private:
-    std::vector<sf::Sprite> sprites;
-};
+    const Json::Value& mouse = config["mouse"];
+    if (mouse.isObject()) {
+        add_path(mouse["image"]);
+        if (mouse["buttons"].isObject()) {
+            add_path(mouse["buttons"]["left"]);
+            add_path(mouse["buttons"]["right"]);
+        }
+    }
+}
 
 }
 
 namespace cats {
 
-bool CatKeyboardGroup::Key::is_pressed() const {
-    if (is_joystick) {
-        for(auto code : codes) {
-            if(!input::is_joystick_pressed(code))
-                return false;
-        }
+bool CatKeyboardGroup::Key::is_pressed(const input::InputFrame& frame) const {
+    for(const auto& mask : key_masks) {
+        if(!input::is_pressed(frame, mask))
+            return false;
     }
-    else {
-        for(auto code : codes) {
-            if(!input::is_pressed(code))
-                return false;
+    return input::is_joystick_pressed(frame, joystick_codes);
+}
+
+int CatKeyboardGroup::Key::find_press_order(const input::InputFrame& frame) const {
+    int order = -1;
+    for(size_t i = 0; i < frame.key_presses.size(); ++i) {
+        for(const auto& mask : key_masks) {
+            if(mask.test(frame.key_presses[i].keycode))
+                order = i;
         }
     }
-    return true;
+    return order;
+}
+
+void CatKeyboardGroup::Key::update(const input::InputFrame& frame, int min_frames) {
+    const bool is_down = is_pressed(frame);
+    press_order = find_press_order(frame);
+
+    // a key is pressed anew if any of its keys went down since the previous
+    // frame, even if the key is still displayed after an earlier press
+    new_press = is_down && (press_order >= 0 || !active);
+    if (new_press)
+        frames_left = min_frames;
+
+    // short taps are displayed for at least min_frames frames
+    active = is_down || frames_left > 0;
+    if (frames_left > 0)
+        --frames_left;
 }
 
-void CatKeyboardGroup::init(const Json::Value& keys_config) {
+void CatKeyboardGroup::init(const Json::Value& keys_config, int min_frames) {
+    min_press_frames = min_frames;
+
     if (keys_config.isMember("defaultImages")) {
         if (!keys_config["defaultImages"].isArray())
             throw std::runtime_error("defaultImages must be an array");
-        auto sprites = std::make_unique<SpriteArray>();
-        for (const auto& image : keys_config["defaultImages"])
-            sprites->add(sf::Sprite(data::load_texture(image.asString())));
-        def_kbg = std::move(sprites);
+        // the images drawn together may have been composited into one
+        default_images = data::load_texture_regions(get_image_paths(keys_config["defaultImages"]));
     }
 
     if (!keys_config.isMember("keyBindings"))
@@ -87,103 +146,166 @@ void CatKeyboardGroup::init(const Json::Value& keys_config) {
         if (binding.isMember("isPersistent"))
             is_persistent = binding["isPersistent"].asBool();
 
-        auto sprite = std::make_unique<SpriteArray>();
-        for (const auto& image : binding["images"])
-            sprite->add(sf::Sprite(data::load_texture(image.asString())));
-        sprites.push_back(std::move(sprite));
+        images.push_back(data::load_texture_regions(get_image_paths(binding["images"])));
 
         for (auto json_code : binding["keyCodes"]) {
-            Key key(key_id, is_persistent, false);
-            auto key_code = data::json_key_to_scancodes(json_code, false);
-            key.add_codes(key_code);
+            Key key(key_id, is_persistent);
+            // resolve key codes into X keycodes once, so that
+            // checking the key state per frame is just a bit test
+            key.add_keys(data::json_key_to_keymasks(json_code));
+            if (key.is_empty())
+                continue;
             if (json_code.isArray())
                 combined_keys.push_back(key);
             else
                 released_keys.push_back(key);
-            key_actions[key_id] = sprites.back().get();
+            key_actions[key_id] = images.size() - 1;
+            key_codes[key_id] = json_code;
             ++key_id;
         }
 
         for (auto json_code : binding["joyCodes"]) {
-            Key key(key_id, is_persistent, true);
-            auto key_code = data::json_key_to_scancodes(json_code, true);
-            key.add_codes(key_code);
+            Key key(key_id, is_persistent);
+            key.add_joystick_codes(data::json_joy_key_to_mask(json_code));
+            if (key.is_empty())
+                continue;
             if (json_code.isArray())
                 combined_keys.push_back(key);
             else
                 released_keys.push_back(key);
-            key_actions[key_id] = sprites.back().get();
+            key_actions[key_id] = images.size() - 1;
             ++key_id;
         }
     }
 }
 
-void CatKeyboardGroup::update() {
-    // Update states for the keys which currently are not pressed down
-    move_if(pressed_keys, released_keys, 
-        [&](Key key){ return key.is_pressed(); });
-    // Update states for combined keys and append them at the end of the list
+void CatKeyboardGroup::resolve_keys() {
+    for (auto* keys : {&released_keys, &combined_keys, &pressed_keys, &persistent_keys}) {
+        for (auto& key : *keys) {
+            const auto codes = key_codes.find(key.get_id());
+            if (codes != key_codes.end())
+                key.set_keys(data::json_key_to_keymasks(codes->second));
+        }
+    }
+}
+
+bool CatKeyboardGroup::update(const input::InputFrame& frame) {
+    // only the latest pressed key and the persistent ones are drawn
+    auto get_top_key_id = [this]() {
+        return pressed_keys.empty() ? -1 : pressed_keys.back().get_id();
+    };
+    const int top_key_id = get_top_key_id();
+
+    for (auto* keys : {&released_keys, &combined_keys, &pressed_keys, &persistent_keys}) {
+        for (auto& key : *keys)
+            key.update(frame, min_press_frames);
+    }
+
+    // Collect the keys pressed since the previous frame, including the ones
+    // which are pressed again while they are still displayed
+    std::list<Key> new_keys, new_combined_keys;
+    move_if(new_keys, released_keys, 
+        [&](const Key& key){ return key.is_new_press(); });
+    move_if(new_keys, pressed_keys, 
+        [&](const Key& key){ return key.is_new_press() && !key.is_combined(); });
+    move_if(new_combined_keys, combined_keys, 
+        [&](const Key& key){ return key.is_new_press(); });
+    move_if(new_combined_keys, pressed_keys, 
+        [&](const Key& key){ return key.is_new_press() && key.is_combined(); });
+
+    // Append the new keys in the order they have been pressed, so that
+    // the latest one is displayed even if several presses occured in one frame
+    auto by_press_order = [](const Key& a, const Key& b) {
+        return a.get_press_order() < b.get_press_order();
+    };
+    new_keys.sort(by_press_order);
+    new_combined_keys.sort(by_press_order);
+    pressed_keys.splice(pressed_keys.end(), new_keys);
+    // Combined keys are appended at the end of the list
     // to make sure they have priority over single keys
-    move_if(pressed_keys, combined_keys, 
-        [&](Key key){ return key.is_pressed(); });
+    pressed_keys.splice(pressed_keys.end(), new_combined_keys);
+
     // Some key bindings are marked as pesistent, store them separately
-    move_if(persistent_keys, pressed_keys, 
-        [&](Key key){ return key.is_persistent(); });
+    bool is_changed = move_if(persistent_keys, pressed_keys, 
+        [&](const Key& key){ return key.is_persistent(); });
     // Update states for pressed keys which have been released
     move_if(released_keys, pressed_keys, 
-        [&](Key key){ return !key.is_pressed() && !key.is_combined(); });
+        [&](const Key& key){ return !key.is_active() && !key.is_combined(); });
     // Update states for pressed combined keys which have been released
     move_if(combined_keys, pressed_keys, 
-        [&](Key key){ return !key.is_pressed() && key.is_combined(); });
+        [&](const Key& key){ return !key.is_active() && key.is_combined(); });
     // Update states for pesistent keys which have been released
-    move_if(released_keys, persistent_keys, 
-        [&](Key key){ return !key.is_pressed() && !key.is_combined(); });
+    is_changed |= move_if(released_keys, persistent_keys, 
+        [&](const Key& key){ return !key.is_active() && !key.is_combined(); });
     // Update states for pesistent combined keys which have been released
-    move_if(combined_keys, persistent_keys, 
-        [&](Key key){ return !key.is_pressed() && key.is_combined(); });
+    is_changed |= move_if(combined_keys, persistent_keys, 
+        [&](const Key& key){ return !key.is_active() && key.is_combined(); });
+
+    return is_changed || get_top_key_id() != top_key_id;
 }
     
-void CatKeyboardGroup::draw(sf::RenderTarget& target, sf::RenderStates rst) const {
+void CatKeyboardGroup::add_to(SpriteQueue& queue) const {
+    auto add_images = [&queue](const Images& binding_images) {
+        for (const auto& image : binding_images)
+            queue.add(image);
+    };
+
     // draw persistent bindings
     for (auto pk : persistent_keys) {
-        target.draw(*key_actions.at(pk.get_id()), rst);
+        add_images(images[key_actions.at(pk.get_id())]);
     }
 
     if(pressed_keys.empty()) {
-        if(def_kbg)
-            target.draw(*def_kbg, rst);
+        add_images(default_images);
     }
     else {
         // draw the latest pressed key sprite
-        target.draw(*key_actions.at(pressed_keys.back().get_id()), rst);
+        add_images(images[key_actions.at(pressed_keys.back().get_id())]);
     }
 }
 
-bool CustomCat::init(const data::Settings&, const Json::Value& config) {
+bool CustomCat::init(const data::Settings& settings, const Json::Value& config, const RenderParameters& render) {
     // getting configs
     try {
         kbd_groups.clear();
         if (!config.isMember("background") || !config["background"].isString())
             throw std::runtime_error("Custom background not found");
 
-        bg = std::make_unique<sf::Sprite>(data::load_texture(config["background"].asString()));
+        // all the images of the cat are packed into atlases before the sprites are made
+        // at the scale they are drawn at on the window, only the paw is scaled by the transform
+        std::vector<std::vector<std::string>> image_groups;
+        collect_images(config, image_groups);
+        data::set_texture_scale(render.scale);
+        data::pack_textures(image_groups);
+
+        bg = data::load_texture_region(config["background"].asString());
+
+        // the background is the only layer which never changes, it is rendered
+        // as it is drawn on the window, or on the scene scaled to the window;
+        // a mode switch, a reload or a resize of the window make a new cat,
+        // so the layers are rendered again
+        static_layers.reset();
+        if (settings.is_layer_cache_enabled())
+            render_static_layers(render.size, render.transform, settings.get_background_color());
 
         if (config.isMember("keyboard")) {
             if(config["keyboard"].isArray()){
                 for(auto kbd_section : config["keyboard"]) {
                     auto kbind = std::make_unique<CatKeyboardGroup>();
-                    kbind->init(kbd_section);
+                    kbind->init(kbd_section, settings.get_min_press_frames());
                     kbd_groups.push_back(std::move(kbind));
                 }
             }
             else {
                 auto kbind = std::make_unique<CatKeyboardGroup>();
-                kbind->init(config["keyboard"]);
+                kbind->init(config["keyboard"], settings.get_min_press_frames());
                 kbd_groups.push_back(std::move(kbind));
             }
         }
         
         if (config.isMember("mouse")) {
+            MousePaw::set_render_scale(render.scale);
+            MousePaw::set_pose_cache_size(settings.get_paw_cache_size());
             is_mouse = init_mouse(config["mouse"]);
         }
         else {
@@ -195,6 +317,9 @@ bool CustomCat::init(const data::Settings&, const Json::Value& config) {
         logger::error(std::string("Config error: ") + e.what());
         return false;
     }
+    build_layers();
+    is_batch_dirty = true;
+    is_moving_batch_dirty = true;
     return true;
 }
 
@@ -214,7 +339,7 @@ bool CustomCat::init_mouse(const Json::Value& config) {
     if (!image_path)
         throw std::runtime_error("No image is set in mouse config section");
 
-    device = std::make_unique<sf::Sprite>(data::load_texture(image_path.value()));
+    device = std::make_unique<AtlasSprite>(data::load_texture_region(image_path.value()));
     MousePaw::set_mouse_parameters(offset, scale);
 
     if (config.isMember("buttons")) {
@@ -223,9 +348,9 @@ bool CustomCat::init_mouse(const Json::Value& config) {
         const auto rb_image_path = key_bindings.getProperty<std::string>("right");
 
         if (lb_image_path)
-            left_button = std::make_unique<sf::Sprite>(data::load_texture(lb_image_path.value()));
+            left_button = std::make_unique<AtlasSprite>(data::load_texture_region(lb_image_path.value()));
         if (rb_image_path)
-            right_button = std::make_unique<sf::Sprite>(data::load_texture(rb_image_path.value()));
+            right_button = std::make_unique<AtlasSprite>(data::load_texture_region(rb_image_path.value()));
     }
 
     if (!MousePaw::init(config, config))
@@ -234,43 +359,173 @@ bool CustomCat::init_mouse(const Json::Value& config) {
     return cfg.getProperty("isEnabled", true);
 }
 
-void CustomCat::update() {
+bool CustomCat::update(const input::InputFrame& frame) {
+    bool is_moved = false;
+
     if (is_mouse) {
         // update mouse and paw position
-        update_paw_position(input::get_mouse_input().get_position());
+        is_moved |= update_paw_position(frame.mouse_pos);
     }
 
+    is_moved |= is_left_button_pressed != frame.is_left_button_pressed && left_button;
+    is_moved |= is_right_button_pressed != frame.is_right_button_pressed && right_button;
+    is_left_button_pressed = frame.is_left_button_pressed;
+    is_right_button_pressed = frame.is_right_button_pressed;
+
+    bool is_changed = false;
+    for (auto& kbd_group : kbd_groups)
+        is_changed |= kbd_group->update(frame);
+
+    is_batch_dirty |= is_changed;
+    if (is_batch_dirty)
+        update_batches();
+
+    is_moving_batch_dirty |= is_moved;
+    if (is_moving_batch_dirty)
+        update_moving_batches();
+
+    return is_changed || is_moved;
+}
+
+void CustomCat::resolve_keys() {
+    logger::info("The keyboard mapping has changed, resolving the key bindings again");
     for (auto& kbd_group : kbd_groups)
-        kbd_group->update();
+        kbd_group->resolve_keys();
 }
 
-void CustomCat::draw(sf::RenderTarget& target, sf::RenderStates rst) const {
-    target.draw(*bg, rst);
+void CustomCat::update_mouse(const input::InputFrame& frame) {
+    if (is_mouse && update_paw_position(frame.mouse_pos))
+        update_moving_batches();
+}
 
-    if (is_mouse) {
-        // drawing mouse on top
-        if (is_mouse_on_top) {
-            target.draw(*device, rst);
+void CustomCat::build_layers() {
+    using Kind = Layer::Kind;
+    layers.clear();
+
+    // the background is drawn from the render texture if it is cached
+    if (!static_layers)
+        layers.push_back({[this](SpriteQueue& queue) { queue.add(bg); }});
+
+    // drawing mouse on top
+    if (is_mouse && is_mouse_on_top)
+        layers.push_back({[this](SpriteQueue& queue) { device->add_to(queue); }, Kind::Moving});
+
+    if (is_mouse)
+        layers.push_back({nullptr, Kind::Paw});
+
+    // keyboard bindings
+    for (auto& kbd_group : kbd_groups) {
+        const CatKeyboardGroup* group = kbd_group.get();
+        layers.push_back({[group](SpriteQueue& queue) { group->add_to(queue); }});
+    }
+
+    // drawing mouse at the bottom
+    if (is_mouse && !is_mouse_on_top)
+        layers.push_back({[this](SpriteQueue& queue) { device->add_to(queue); }, Kind::Moving});
+
+    // mouse buttons
+    if (left_button) {
+        layers.push_back({[this](SpriteQueue& queue) {
+            if (is_left_button_pressed)
+                left_button->add_to(queue);
+        }, Kind::Moving});
+    }
+    if (right_button) {
+        layers.push_back({[this](SpriteQueue& queue) {
+            if (is_right_button_pressed)
+                right_button->add_to(queue);
+        }, Kind::Moving});
+    }
+
+    // the batches hold vertex buffers, so they are made once in place
+    passes.clear();
+    passes.reserve(layers.size());
+    std::size_t group = 0;
+    for (std::size_t i = 0; i < layers.size(); ++i) {
+        if (!passes.empty() && passes.back().kind == layers[i].kind && layers[i].kind != Kind::Paw) {
+            passes.back().last_layer = i + 1;
+            continue;
         }
 
-        // draw mouse paw
-        draw_paw(target, rst);
+        // the still sprites between the other passes make up a group of the queue
+        if (!passes.empty() && passes.back().kind == Kind::Still)
+            ++group;
+        passes.emplace_back(layers[i].kind, i, group);
     }
+}
 
-    // draw keyboard bindings
-    for (auto& kbd_group : kbd_groups)
-        kbd_group->draw(target, rst);
+void CustomCat::update_batches() {
+    // the still sprites of all the passes are arranged together, so that
+    // the ones covered by a sprite of a later pass are dropped as well
+    sprite_queue.clear();
+    for (const auto& pass : passes) {
+        if (pass.kind != Layer::Kind::Still)
+            continue;
+        for (std::size_t i = pass.first_layer; i < pass.last_layer; ++i)
+            layers[i].add_sprites(sprite_queue);
+        sprite_queue.next_group();
+    }
+    sprite_queue.arrange();
+
+    for (auto& pass : passes) {
+        if (pass.kind != Layer::Kind::Still)
+            continue;
+        pass.batch.clear();
+        sprite_queue.add_group_to(pass.group, pass.batch);
+        pass.batch.upload();
+    }
 
-    // drawing mouse at the bottom
-    if (is_mouse && !is_mouse_on_top) {
-        target.draw(*device, rst);
+    is_batch_dirty = false;
+}
+
+void CustomCat::update_moving_batches() {
+    for (auto& pass : passes) {
+        if (pass.kind != Layer::Kind::Moving)
+            continue;
+
+        moving_queue.clear();
+        for (std::size_t i = pass.first_layer; i < pass.last_layer; ++i)
+            layers[i].add_sprites(moving_queue);
+        moving_queue.arrange();
+
+        pass.batch.clear();
+        moving_queue.add_group_to(0, pass.batch);
+        pass.batch.upload();
+    }
+
+    is_moving_batch_dirty = false;
+}
+
+void CustomCat::render_static_layers(sf::Vector2u size, const sf::Transform& transform, sf::Color color) {
+    SpriteBatch static_batch;
+    static_batch.add(bg);
+    static_batch.upload();
+
+    static_layers.emplace();
+    if (!static_layers->resize(size)) {
+        logger::warn("Failed to create a render texture, the static layers are not cached");
+        static_layers.reset();
+        return;
     }
 
-    // draw mouse buttons
-    if(input::get_mouse_input().is_left_button_pressed())
-        target.draw(*left_button, rst);
-    if(input::get_mouse_input().is_right_button_pressed())
-        target.draw(*right_button, rst);
+    // the texture is opaque, so it replaces clearing the target every frame
+    static_layers->clear(color);
+    static_layers->draw(static_batch, sf::RenderStates(transform));
+    static_layers->display();
+}
+
+void CustomCat::draw(sf::RenderTarget& target, sf::RenderStates rst) const {
+    if (static_layers) {
+        // the texture already holds the layers as they are on the target,
+        // over its background, so it is copied without blending
+        target.draw(sf::Sprite(static_layers->getTexture()), sf::RenderStates(sf::BlendNone));
+    }
+    for (const auto& pass : passes) {
+        if (pass.kind == Layer::Kind::Paw)
+            draw_paw(target, rst);
+        else
+            target.draw(pass.batch, rst);
+    }
 }
 
 } // namespace cats
@@ -1,5 +1,9 @@
 #include <header.hpp>
+#include <pacer.hpp>
 #include <json/value.h>
+#include <cmath>
+#include <cstdint>
+#include <list>
 #include <memory>
 #include <stdexcept>
 #include <system.hpp>
@@ -10,9 +14,21 @@
 
 #include <unistd.h>
 
+// largest side of an atlas texture
+#define ATLAS_MAX_SIZE 4096u
+// transparent pixels between the images in an atlas,
+// so that the neighbours do not bleed into a scaled image
+#define ATLAS_PADDING 1u
+
 namespace data {
 std::unique_ptr<sf::Font> debug_font_holder;
 std::map<std::string, sf::Texture> img_holder;
+std::list<sf::Texture> atlas_holder;
+std::map<std::string, TextureRegion> region_holder;
+// scale the images are packed at
+float texture_scale = 1.0f;
+// scale the images in the atlases have been packed at
+float packed_scale = 1.0f;
 
 template<class C, class T>
 bool contains(C container, T object) {
@@ -57,31 +73,127 @@ sf::Transform Settings::get_window_transform() const {
     scene_pos.x = std::clamp(window_offset.x, 0u, window_size.x);
     scene_pos.y = std::clamp(window_offset.y, 0u, window_size.y);
 
+    const float scale = get_window_scale();
+
+    sf::Transform transform = sf::Transform();
+    transform.translate(scene_pos);
+    transform.scale(sf::Vector2f(scale, scale));
+
+    return transform;
+}
+
+float Settings::get_window_scale() const {
+    auto window_config = config["window"];
+    const sf::Vector2u window_size = get_window_size();
+    const sf::Vector2u window_offset = value_or(window_config["offset"], sf::Vector2u(0, 0));
+
     const bool is_adaptive = window_config["adaptive"].isNull() ?
         false : window_config["adaptive"].asBool();
 
     const float cfg_scale = window_config["scale"].isNull() ?
         1.0f : window_config["scale"].asFloat();
 
-    sf::Transform transform = sf::Transform();
-    transform.translate(scene_pos);
-    transform.scale(sf::Vector2f(cfg_scale, cfg_scale));
+    if(!is_adaptive)
+        return cfg_scale;
 
-    if(is_adaptive) {
-        sf::Vector2f relative_scale;
-        relative_scale.x = float(window_size.x - window_offset.x) / g_window_default_size.x;
-        relative_scale.y = float(window_size.y - window_offset.y) / g_window_default_size.y;
-        const float min_scale = std::min(relative_scale.x, relative_scale.y);
-        transform.scale(sf::Vector2f(min_scale, min_scale));
-    }
+    sf::Vector2f relative_scale;
+    relative_scale.x = float(window_size.x - window_offset.x) / g_window_default_size.x;
+    relative_scale.y = float(window_size.y - window_offset.y) / g_window_default_size.y;
+    const float min_scale = std::min(relative_scale.x, relative_scale.y);
+    return cfg_scale * min_scale;
+}
 
-    return transform;
+// Returns the factor the window is reduced by to the render resolution;
+// the aspect ratio is kept and the image is never larger than the window
+static float get_render_factor(const Json::Value& window_config, sf::Vector2u window_size) {
+    const Json::Value& resolution = window_config["renderResolution"];
+    if (!resolution.isArray() || !resolution[0].isUInt() || !resolution[1].isUInt()
+        || resolution[0].asUInt() == 0 || resolution[1].asUInt() == 0)
+        return 1.0f;
+
+    const float factor = std::min(float(resolution[0].asUInt()) / window_size.x,
+                                  float(resolution[1].asUInt()) / window_size.y);
+    return std::min(factor, 1.0f);
+}
+
+sf::Vector2u Settings::get_render_size() const {
+    const sf::Vector2u window_size = get_window_size();
+    const float factor = get_render_factor(config["window"], window_size);
+    return sf::Vector2u(std::max(1l, std::lround(window_size.x * factor)),
+                        std::max(1l, std::lround(window_size.y * factor)));
+}
+
+sf::Transform Settings::get_render_transform() const {
+    const sf::Vector2u window_size = get_window_size();
+    const sf::Vector2u render_size = get_render_size();
+
+    // the image is stretched over the whole window, so it is reduced
+    // along each axis by exactly the same factor it is enlarged later
+    sf::Transform transform;
+    transform.scale(sf::Vector2f(float(render_size.x) / window_size.x, float(render_size.y) / window_size.y));
+    return transform * get_window_transform();
+}
+
+float Settings::get_render_scale() const {
+    return get_window_scale() * get_render_factor(config["window"], get_window_size());
+}
+
+bool Settings::is_render_on_change() const {
+    const Json::Value& on_change = config["window"]["renderOnChange"];
+    return on_change.isBool() && on_change.asBool();
+}
+
+int Settings::get_frame_rate() const {
+    const Json::Value& vsync = config["window"]["vsync"];
+    if (vsync.isBool() && vsync.asBool())
+        return timing::FramePacer::VSYNC;
+
+    const Json::Value& rate = config["window"]["frameRate"];
+    return rate.isInt() ? std::clamp(rate.asInt(), MIN_FRAME_RATE, MAX_FRAME_RATE) : DEFAULT_FRAME_RATE;
+}
+
+std::size_t Settings::get_paw_cache_size() const {
+    // the size is set in MiB
+    const Json::Value& size = config["window"]["pawCacheSize"];
+    return size.isInt() ? std::size_t(std::clamp(size.asInt(), 0, 1024)) << 20 : 0;
+}
+
+bool Settings::is_layer_cache_enabled() const {
+    const Json::Value& cache_layers = config["window"]["cacheLayers"];
+    return cache_layers.isBool() && cache_layers.asBool();
 }
 
 bool Settings::is_mouse_left_handed() const {
     return config["decoration"]["leftHanded"].asBool();
 }
 
+int Settings::get_min_press_frames() const {
+    const Json::Value& frames = config["input"]["minPressFrames"];
+    return frames.isInt() ? std::max(frames.asInt(), 1) : 1;
+}
+
+int Settings::get_input_sampling_rate() const {
+    const Json::Value& rate = config["input"]["samplingRate"];
+    return rate.isInt() ? std::clamp(rate.asInt(), 0, 2000) : 0;
+}
+
+std::string Settings::get_input_monitor() const {
+    const Json::Value& monitor = config["input"]["monitor"];
+    if (monitor.isUInt())
+        return std::to_string(monitor.asUInt());
+    return monitor.isString() ? monitor.asString() : std::string();
+}
+
+std::string Settings::get_input_backend() const {
+    const Json::Value& backend = config["input"]["backend"];
+    return backend.isString() ? backend.asString() : "x11";
+}
+
+bool Settings::is_mouse_late_latched() const {
+    const Json::Value& late_latch = config["input"]["lateLatch"];
+    return late_latch.isBool() && late_latch.asBool();
+}
+
 sf::Color Settings::get_background_color() const {
     Json::Value rgb = config["decoration"]["rgb"];
     int red_value = rgb[0].asInt();
@@ -104,19 +216,23 @@ std::vector<std::string> Settings::get_cat_modes() const {
     return modes;
 }
 
-std::optional<int> json_key_to_scancode(const Json::Value& key) {
+std::optional<input::KeyMask> json_key_to_keymask(const Json::Value& key) {
     if (key.isInt()) {
-        return key.asInt();
+        return input::resolve_key_code(key.asInt());
     }
     else if (key.isString()) {
         std::string s = key.asString();
-        if (s.size() != 1) {
-            logger::error("Error reading configs: Invalid key value: " + s);
-        }
-        else {
+        if (s.size() == 1) {
             // treat uppercase and lowercase letters equally
             char c = std::toupper(s[0]);
-            return static_cast<int>(c);
+            return input::resolve_key_code(static_cast<int>(c));
+        }
+        else {
+            // longer strings are X keysym names, e.g. KP_Decimal
+            auto mask = input::resolve_key_name(s);
+            if (!mask.has_value())
+                logger::error("Error reading configs: Invalid key value: " + s);
+            return mask;
         }
     }
     else {
@@ -126,7 +242,7 @@ std::optional<int> json_key_to_scancode(const Json::Value& key) {
 }
 
 std::optional<int> json_joy_key_to_scancode(const Json::Value& key) {
-    if (key.isInt()) {
+    if (key.isInt() && key.asInt() >= 0 && key.asInt() < (int)input::JoystickMask().size()) {
         return key.asInt();
     }
     else {
@@ -135,25 +251,42 @@ std::optional<int> json_joy_key_to_scancode(const Json::Value& key) {
     return std::nullopt;
 }
 
-std::set<int> json_key_to_scancodes(const Json::Value& key, bool is_joystick) {
-    std::set<int> codes;
+std::vector<input::KeyMask> json_key_to_keymasks(const Json::Value& key) {
+    std::vector<input::KeyMask> masks;
 
     if (key.isArray()) {
         for (const Json::Value &v : key) {
-            auto code = is_joystick 
-                ? json_joy_key_to_scancode(v) 
-                : json_key_to_scancode(v);
+            auto mask = json_key_to_keymask(v);
+            if (mask.has_value()) {
+                masks.push_back(*mask);
+            }
+        }
+    }
+    else {
+        auto mask = json_key_to_keymask(key);
+        if (mask.has_value()) {
+            masks.push_back(*mask);
+        }
+    }
+
+    return masks;
+}
+
+input::JoystickMask json_joy_key_to_mask(const Json::Value& key) {
+    input::JoystickMask codes;
+
+    if (key.isArray()) {
+        for (const Json::Value &v : key) {
+            auto code = json_joy_key_to_scancode(v);
             if (code.has_value()) {
-                codes.insert(*code);
+                codes.set(*code);
             }
         }
     }
     else {
-        auto code = is_joystick 
-            ? json_joy_key_to_scancode(key) 
-            : json_key_to_scancode(key);
+        auto code = json_joy_key_to_scancode(key);
         if (code.has_value()) {
-            codes.insert(*code);
+            codes.set(*code);
         }
     }
 
@@ -347,6 +480,373 @@ sf::Texture &load_texture(std::string path) {
     throw std::runtime_error("Error importing images: Cannot open file " + full_path.string());
 }
 
+// Returns the file the image is read from; a relative path is looked
+// for in the application's directory first, then in the current one
+static std::filesystem::path find_image_file(const std::string& path) {
+    const auto system_info = os::create_system_info();
+    const std::filesystem::path full_path = path[0] == '/'
+        ? std::filesystem::path(path)
+        : system_info->get_app_dir_path() / path;
+
+    if (std::filesystem::exists(full_path))
+        return full_path;
+    if (std::filesystem::exists(path))
+        return path;
+
+    throw std::runtime_error("Error importing images: Cannot open file " + full_path.string());
+}
+
+void set_texture_scale(float scale) {
+    texture_scale = scale > 0 ? scale : 1.0f;
+}
+
+// Returns the smallest rectangle containing all the pixels
+// of the image which are not fully transparent
+static sf::IntRect find_visible_bounds(const sf::Image& image) {
+    const sf::Vector2u size = image.getSize();
+    const std::uint8_t* pixels = image.getPixelsPtr();
+
+    sf::Vector2u min = size, max(0, 0);
+    for (unsigned int y = 0; y < size.y; ++y) {
+        // the pixels are stored as RGBA bytes, row by row
+        const std::uint8_t* row = pixels + 4 * size_t(y) * size.x;
+        for (unsigned int x = 0; x < size.x; ++x) {
+            if (row[4 * x + 3] == 0)
+                continue;
+            min = {std::min(min.x, x), std::min(min.y, y)};
+            max = {std::max(max.x, x + 1), std::max(max.y, y + 1)};
+        }
+    }
+
+    if (min.x >= max.x || min.y >= max.y)
+        return sf::IntRect();
+    return sf::IntRect(sf::Vector2i(min), sf::Vector2i(max - min));
+}
+
+// Returns the key a group of images drawn over each other is stored under,
+// the path of the image itself if there is only one; the images resampled
+// for another scale are stored separately
+static std::string region_key(const std::vector<std::string>& paths) {
+    std::string key;
+    for (const auto& path : paths)
+        key += (key.empty() ? "" : "\n") + path;
+    if (texture_scale != 1.0f)
+        key += "@" + std::to_string(texture_scale);
+    return key;
+}
+
+// Resamples the image to the scale with a tent filter, as wide as a pixel
+// of the larger of both images, so it interpolates linearly when the image
+// is enlarged and averages all the pixels covered when it is reduced.
+// The colors are weighted by their alpha, so transparent pixels do not
+// darken the edges of the visible ones
+static sf::Image resample_image(const sf::Image& image, float scale) {
+    const sf::Vector2u size = image.getSize();
+    const sf::Vector2u scaled_size(std::max(1l, std::lround(size.x * scale)),
+                                   std::max(1l, std::lround(size.y * scale)));
+
+    struct Tap
+    {
+        unsigned int source;
+        float weight;
+    };
+
+    // the source pixels every pixel of the scaled image is made of, along one axis
+    auto compute_taps = [](unsigned int source_size, unsigned int target_size) {
+        const double ratio = double(source_size) / target_size;
+        const double radius = std::max(1.0, ratio);
+
+        std::vector<std::vector<Tap>> taps(target_size);
+        for (unsigned int i = 0; i < target_size; ++i) {
+            const double center = (i + 0.5) * ratio - 0.5;
+            const long first = std::max(0l, long(std::ceil(center - radius)));
+            const long last = std::min(long(source_size) - 1, long(std::floor(center + radius)));
+
+            double total = 0;
+            for (long j = first; j <= last; ++j) {
+                const double weight = 1 - std::abs(j - center) / radius;
+                if (weight > 0) {
+                    taps[i].push_back({unsigned(j), float(weight)});
+                    total += weight;
+                }
+            }
+            if (taps[i].empty())
+                taps[i].push_back({unsigned(std::clamp(long(std::lround(center)), 0l, long(source_size) - 1)), 1});
+            else
+                for (auto& tap : taps[i])
+                    tap.weight /= total;
+        }
+        return taps;
+    };
+
+    const auto x_taps = compute_taps(size.x, scaled_size.x);
+    const auto y_taps = compute_taps(size.y, scaled_size.y);
+
+    // the source pixels with the colors multiplied by alpha, in the range of 0 to 1
+    const std::uint8_t* pixels = image.getPixelsPtr();
+    std::vector<float> source(4 * size_t(size.x) * size.y);
+    for (size_t i = 0; i < size_t(size.x) * size.y; ++i) {
+        const float alpha = pixels[4 * i + 3] / 255.0f;
+        for (int c = 0; c < 3; ++c)
+            source[4 * i + c] = pixels[4 * i + c] / 255.0f * alpha;
+        source[4 * i + 3] = alpha;
+    }
+
+    // resample the rows first, then the columns
+    std::vector<float> rows(4 * size_t(scaled_size.x) * size.y, 0.0f);
+    for (unsigned int y = 0; y < size.y; ++y) {
+        for (unsigned int x = 0; x < scaled_size.x; ++x) {
+            float* dst = &rows[4 * (size_t(y) * scaled_size.x + x)];
+            for (const auto& tap : x_taps[x]) {
+                const float* src = &source[4 * (size_t(y) * size.x + tap.source)];
+                for (int c = 0; c < 4; ++c)
+                    dst[c] += src[c] * tap.weight;
+            }
+        }
+    }
+
+    std::vector<std::uint8_t> scaled(4 * size_t(scaled_size.x) * scaled_size.y);
+    for (unsigned int y = 0; y < scaled_size.y; ++y) {
+        for (unsigned int x = 0; x < scaled_size.x; ++x) {
+            float pixel[4] = {0, 0, 0, 0};
+            for (const auto& tap : y_taps[y]) {
+                const float* src = &rows[4 * (size_t(tap.source) * scaled_size.x + x)];
+                for (int c = 0; c < 4; ++c)
+                    pixel[c] += src[c] * tap.weight;
+            }
+
+            std::uint8_t* dst = &scaled[4 * (size_t(y) * scaled_size.x + x)];
+            const float alpha = std::clamp(pixel[3], 0.0f, 1.0f);
+            for (int c = 0; c < 3; ++c) {
+                const float color = alpha > 0 ? pixel[c] / alpha : 0.0f;
+                dst[c] = std::uint8_t(std::lround(std::clamp(color, 0.0f, 1.0f) * 255));
+            }
+            dst[3] = std::uint8_t(std::lround(alpha * 255));
+        }
+    }
+
+    return sf::Image(scaled_size, scaled.data());
+}
+
+// Composites the images drawn over each other at the same position into one.
+// Alpha blending would round the colors differently, so the images are only
+// composited if no pixel of an image is blended over a visible pixel of the
+// images below it: every pixel is then taken from a single image as it is
+static std::optional<sf::Image> flatten_images(const std::vector<sf::Image>& layers) {
+    sf::Vector2u size(0, 0);
+    for (const auto& layer : layers)
+        size = {std::max(size.x, layer.getSize().x), std::max(size.y, layer.getSize().y)};
+
+    // the pixels are stored as RGBA bytes, row by row
+    std::vector<std::uint8_t> pixels(4 * size_t(size.x) * size.y, 0);
+    for (const auto& layer : layers) {
+        const sf::Vector2u layer_size = layer.getSize();
+        const std::uint8_t* layer_pixels = layer.getPixelsPtr();
+
+        for (unsigned int y = 0; y < layer_size.y; ++y) {
+            for (unsigned int x = 0; x < layer_size.x; ++x) {
+                const std::uint8_t* src = layer_pixels + 4 * (size_t(y) * layer_size.x + x);
+                std::uint8_t* dst = pixels.data() + 4 * (size_t(y) * size.x + x);
+
+                // a transparent pixel leaves the pixels below it as they are, an opaque one
+                // or one over transparent pixels is drawn as it is; anything else is a blend
+                if (src[3] == 0)
+                    continue;
+                if (src[3] != 255 && dst[3] != 0)
+                    return std::nullopt;
+                std::copy(src, src + 4, dst);
+            }
+        }
+    }
+
+    return sf::Image(size, pixels.data());
+}
+
+// Returns true if no pixel of the image is transparent at all
+static bool is_opaque(const sf::Image& image) {
+    const sf::Vector2u size = image.getSize();
+    const std::uint8_t* pixels = image.getPixelsPtr();
+    for (size_t i = 0; i < size_t(size.x) * size.y; ++i) {
+        if (pixels[4 * i + 3] != 255)
+            return false;
+    }
+    return true;
+}
+
+void pack_textures(const std::vector<std::vector<std::string>>& groups) {
+    struct Packed
+    {
+        // path of the image or the key of the composited group
+        std::string path;
+        sf::Image image;
+        // position of the trimmed image in the original one
+        sf::Vector2f offset;
+        // the scale the image has actually been resampled by
+        sf::Vector2f scale = {1.0f, 1.0f};
+        size_t page = 0;
+        sf::Vector2u position;
+    };
+
+    // the atlases hold the images of a single scale, the ones resampled for
+    // the previous scale are released; a new cat is made from the new atlases
+    if (texture_scale != packed_scale) {
+        region_holder.clear();
+        atlas_holder.clear();
+        packed_scale = texture_scale;
+    }
+
+    std::vector<Packed> images;
+    auto is_loaded = [&images](const std::string& key) {
+        return region_holder.count(key) > 0 || std::any_of(images.begin(), images.end(),
+            [&key](const Packed& packed) { return packed.path == key; });
+    };
+    auto is_path_loaded = [&is_loaded](const std::string& path) {
+        return is_loaded(region_key({path}));
+    };
+
+    // the image is stored at the scale it is resampled by, along each axis
+    auto add_image = [&](const std::string& key, const sf::Image& image, sf::Vector2f scale) {
+        // only the part of the image with any visible pixels is packed, it is drawn
+        // at its place in the original image; whether it covers what is below is
+        // told by is_opaque, which requires every pixel to be fully opaque
+        const sf::IntRect bounds = find_visible_bounds(image);
+        if (bounds.size.x == 0 || bounds.size.y == 0) {
+            region_holder[key] = TextureRegion();
+            return;
+        }
+
+        Packed packed;
+        packed.path = key;
+        packed.offset = sf::Vector2f(bounds.position).componentWiseDiv(scale);
+        packed.scale = scale;
+        packed.image = sf::Image(sf::Vector2u(bounds.size));
+        if (!packed.image.copy(image, {0, 0}, bounds))
+            throw std::runtime_error("Error importing images: Cannot trim file " + key);
+        images.push_back(std::move(packed));
+    };
+
+    for (const auto& group : groups) {
+        // a group whose images are loaded one by one has been found not to composite
+        if (group.empty() || is_loaded(region_key(group))
+            || (group.size() > 1 && std::all_of(group.begin(), group.end(), is_path_loaded)))
+            continue;
+
+        // the images are resampled once here rather than by the window transform every
+        // frame; the resampled size is rounded to whole pixels, so the quads are placed
+        // by the scale between the sizes rather than the one asked for
+        std::vector<sf::Image> layers(group.size());
+        std::vector<sf::Vector2f> scales(group.size(), {1.0f, 1.0f});
+        for (size_t i = 0; i < group.size(); ++i) {
+            sf::Image original;
+            if (!original.loadFromFile(find_image_file(group[i])))
+                throw std::runtime_error("Error importing images: Cannot read file " + group[i]);
+
+            layers[i] = texture_scale != 1.0f ? resample_image(original, texture_scale) : original;
+            scales[i] = sf::Vector2f(layers[i].getSize()).componentWiseDiv(sf::Vector2f(original.getSize()));
+        }
+
+        // the layers are composited after they have been resampled, so the composite
+        // looks the same as the resampled layers blended over each other; layers
+        // resampled by different scales would not line up in a single image
+        const bool is_same_scale = std::all_of(scales.begin(), scales.end(),
+            [&scales](sf::Vector2f scale) { return scale == scales[0]; });
+        if (group.size() > 1 && is_same_scale) {
+            if (auto flat = flatten_images(layers)) {
+                add_image(region_key(group), *flat, scales[0]);
+                continue;
+            }
+        }
+
+        for (size_t i = 0; i < group.size(); ++i) {
+            if (!is_path_loaded(group[i]))
+                add_image(region_key({group[i]}), layers[i], scales[i]);
+        }
+    }
+
+    const unsigned int page_size = std::min(sf::Texture::getMaximumSize(), ATLAS_MAX_SIZE);
+
+    // the images are laid out in rows on the pages, the tallest ones first,
+    // so that the rows waste little space
+    std::stable_sort(images.begin(), images.end(), [](const Packed& a, const Packed& b) {
+        return a.image.getSize().y > b.image.getSize().y;
+    });
+
+    std::vector<sf::Vector2u> page_sizes;
+    sf::Vector2u cursor(0, 0);
+    unsigned int row_height = 0;
+    for (auto& packed : images) {
+        const sf::Vector2u size = packed.image.getSize() + sf::Vector2u(ATLAS_PADDING, ATLAS_PADDING);
+        // an image larger than a page is left in a texture of its own
+        if (size.x > page_size || size.y > page_size)
+            continue;
+
+        if (cursor.x + size.x > page_size) {
+            cursor = {0, cursor.y + row_height};
+            row_height = 0;
+        }
+        if (page_sizes.empty() || cursor.y + size.y > page_size) {
+            page_sizes.emplace_back(0, 0);
+            cursor = {0, 0};
+            row_height = 0;
+        }
+
+        packed.page = page_sizes.size() - 1;
+        packed.position = cursor;
+        cursor.x += size.x;
+        row_height = std::max(row_height, size.y);
+
+        auto& page = page_sizes.back();
+        page.x = std::max(page.x, cursor.x);
+        page.y = std::max(page.y, cursor.y + row_height);
+    }
+
+    std::vector<sf::Texture*> pages;
+    for (const auto& size : page_sizes) {
+        sf::Texture& texture = atlas_holder.emplace_back();
+        if (!texture.resize(size))
+            throw std::runtime_error("Error importing images: Cannot create an atlas texture");
+        pages.push_back(&texture);
+    }
+
+    size_t packed_count = 0;
+    for (const auto& packed : images) {
+        const sf::Vector2u size = packed.image.getSize();
+        if (size.x + ATLAS_PADDING > page_size || size.y + ATLAS_PADDING > page_size)
+            continue;
+
+        sf::Texture& texture = *pages[packed.page];
+        texture.update(packed.image, packed.position);
+        region_holder[packed.path] = {&texture, sf::IntRect(sf::Vector2i(packed.position), sf::Vector2i(size)),
+                                      packed.offset, is_opaque(packed.image), packed.scale};
+        ++packed_count;
+    }
+
+    if (!pages.empty()) {
+        logger::info("Packed " + std::to_string(packed_count) + " images into "
+            + std::to_string(pages.size()) + " atlas textures");
+    }
+}
+
+std::vector<TextureRegion> load_texture_regions(const std::vector<std::string>& paths) {
+    const auto group = region_holder.find(region_key(paths));
+    if (paths.size() > 1 && group != region_holder.end())
+        return {group->second};
+
+    std::vector<TextureRegion> regions;
+    for (const auto& path : paths)
+        regions.push_back(load_texture_region(path));
+    return regions;
+}
+
+TextureRegion load_texture_region(const std::string& path) {
+    const auto region = region_holder.find(region_key({path}));
+    if (region != region_holder.end())
+        return region->second;
+
+    const sf::Texture& texture = load_texture(path);
+    return {&texture, sf::IntRect({0, 0}, sf::Vector2i(texture.getSize())), {0, 0}, false};
+}
+
 sf::Font &get_debug_font() {
     return *debug_font_holder;
 }
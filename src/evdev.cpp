@@ -0,0 +1,471 @@
+#include <header.hpp>
+#include <x11.hpp>
+#include <evdev.hpp>
+extern "C" {
+#include <X11/Xlib.h>
+}
+
+#include <SFML/Window.hpp>
+
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <optional>
+
+#define EVDEV_READ_BATCH 64
+
+// X keycodes of evdev based servers are kernel keycodes shifted by 8
+#define EVDEV_KEYCODE_OFFSET 8
+
+namespace input
+{
+
+namespace
+{
+
+bool test_bit(const unsigned long* bits, unsigned int bit) {
+    const unsigned int word_bits = sizeof(unsigned long) * 8;
+    return (bits[bit / word_bits] >> (bit % word_bits)) & 1;
+}
+
+}
+
+EvdevReader::EvdevReader(const std::string& dir) {
+    if (!init_polling())
+        return;
+
+    open_devices(dir);
+    start();
+}
+
+EvdevReader::EvdevReader(const std::vector<int>& device_fds) {
+    if (!init_polling()) {
+        for (int fd : device_fds)
+            close(fd);
+        return;
+    }
+
+    for (int fd : device_fds) {
+        if (!add_device(fd))
+            close(fd);
+    }
+    start();
+}
+
+EvdevReader::~EvdevReader() {
+    if (thread.joinable()) {
+        // the thread uses the descriptors and the queue, so it is always joined
+        // before they are released; the write fails only if interrupted, or with
+        // EAGAIN if the counter is full, which means the thread is woken up anyway
+        const uint64_t value = 1;
+        while (write(stop_fd, &value, sizeof(value)) < 0 && errno == EINTR) {}
+        thread.join();
+    }
+
+    for (const auto& device : devices)
+        close(device.fd);
+    if (stop_fd >= 0)
+        close(stop_fd);
+    if (epoll_fd >= 0)
+        close(epoll_fd);
+}
+
+bool EvdevReader::init_polling() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd < 0 || stop_fd < 0) {
+        logger::error("Failed to initialize evdev polling");
+        return false;
+    }
+
+    epoll_event stop_evt = {};
+    stop_evt.events = EPOLLIN;
+    stop_evt.data.fd = stop_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &stop_evt);
+    return true;
+}
+
+void EvdevReader::open_devices(const std::string& dir_path) {
+    DIR* dir = opendir(dir_path.c_str());
+    if (!dir) {
+        logger::error("Failed to open " + dir_path);
+        return;
+    }
+
+    while (const dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name.rfind("event", 0) != 0)
+            continue;
+
+        const std::string path = dir_path + "/" + name;
+        const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        // gamepads are read by SFML, only keyboards and mice are of interest
+        unsigned long ev_bits[(EV_MAX + 1) / (sizeof(unsigned long) * 8) + 1] = {};
+        unsigned long key_bits[(KEY_MAX + 1) / (sizeof(unsigned long) * 8) + 1] = {};
+        ioctl(fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits);
+        ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits);
+
+        const bool is_keyboard = test_bit(ev_bits, EV_KEY) && test_bit(key_bits, KEY_A);
+        const bool is_mouse = test_bit(ev_bits, EV_REL) && test_bit(key_bits, BTN_LEFT);
+        if (!is_keyboard && !is_mouse) {
+            close(fd);
+            continue;
+        }
+
+        // timestamps of the monotonic clock are comparable with std::chrono::steady_clock
+        int clock_id = CLOCK_MONOTONIC;
+        ioctl(fd, EVIOCSCLOCKID, &clock_id);
+
+        if (!add_device(fd)) {
+            close(fd);
+            continue;
+        }
+
+        char dev_name[256] = {};
+        ioctl(fd, EVIOCGNAME(sizeof(dev_name) - 1), dev_name);
+        logger::info("Reading input device " + path + " (" + dev_name + ")");
+    }
+
+    closedir(dir);
+
+    if (devices.empty())
+        logger::warn("No readable input devices found in " + dir_path + ", check the permissions");
+}
+
+bool EvdevReader::add_device(int fd) {
+    epoll_event evt = {};
+    evt.events = EPOLLIN;
+    evt.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &evt) < 0)
+        return false;
+
+    devices.push_back({fd});
+    device_count.store(devices.size(), std::memory_order_relaxed);
+    return true;
+}
+
+void EvdevReader::start() {
+    if (is_open())
+        thread = std::thread(&EvdevReader::run, this);
+}
+
+void EvdevReader::close_device(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+
+    devices.erase(std::remove_if(devices.begin(), devices.end(),
+        [fd](const Device& device) { return device.fd == fd; }), devices.end());
+    device_count.store(devices.size(), std::memory_order_relaxed);
+}
+
+void EvdevReader::push(const EvdevEvent& evt) {
+    if (!events.push(evt))
+        is_overflowed.store(true, std::memory_order_relaxed);
+    has_pushed = true;
+}
+
+void EvdevReader::run() {
+    epoll_event ready[16];
+
+    while (true) {
+        const int count = epoll_wait(epoll_fd, ready, 16, -1);
+        if (count < 0 && errno != EINTR)
+            return;
+
+        for (int i = 0; i < count; ++i) {
+            const int fd = ready[i].data.fd;
+            if (fd == stop_fd)
+                return;
+
+            auto it = std::find_if(devices.begin(), devices.end(),
+                [fd](const Device& device) { return device.fd == fd; });
+            if (it == devices.end())
+                continue;
+
+            // the events still buffered are read before an unplugged device is dropped
+            if (ready[i].events & EPOLLIN)
+                read_device(*it);
+
+            // the device has been unplugged
+            if (ready[i].events & (EPOLLERR | EPOLLHUP))
+                close_device(fd);
+        }
+
+        // wake the render loop up once for all the events read at once
+        if (has_pushed) {
+            has_pushed = false;
+            notify_input();
+        }
+    }
+}
+
+void EvdevReader::read_device(Device& device) {
+    input_event buffer[EVDEV_READ_BATCH];
+
+    ssize_t size;
+    while ((size = read(device.fd, buffer, sizeof(buffer))) > 0) {
+        const size_t n = size / sizeof(input_event);
+        for (size_t k = 0; k < n; ++k) {
+            const input_event& ie = buffer[k];
+            const uint64_t time = uint64_t(ie.input_event_sec) * 1000 + ie.input_event_usec / 1000;
+
+            if (ie.type == EV_SYN && ie.code == SYN_DROPPED) {
+                device.is_dropped = true;
+            }
+            else if (device.is_dropped) {
+                // the events up to the next report are incomplete, the state
+                // of the keys is read from the kernel once the report arrives
+                if (ie.type == EV_SYN && ie.code == SYN_REPORT) {
+                    device.is_dropped = false;
+                    resync_keys(time);
+                }
+            }
+            else if (ie.type == EV_KEY || ie.type == EV_REL) {
+                push({ie.type, ie.code, ie.value, time});
+            }
+        }
+    }
+}
+
+void EvdevReader::resync_keys(uint64_t time) {
+    // the consumer merges the keys of all devices, so it releases every key
+    // and gets the keys held on every device again; they are reported
+    // as autorepeats, since they are not new presses
+    push({EV_SYN, SYN_DROPPED, 0, time});
+
+    for (const auto& device : devices) {
+        unsigned long key_bits[(KEY_MAX + 1) / (sizeof(unsigned long) * 8) + 1] = {};
+        if (ioctl(device.fd, EVIOCGKEY(sizeof(key_bits)), key_bits) < 0)
+            continue;
+
+        for (unsigned int code = 0; code <= KEY_MAX; ++code) {
+            if (test_bit(key_bits, code))
+                push({EV_KEY, uint16_t(code), 2, time});
+        }
+    }
+}
+
+class KeyboardEvdev : public IKeyboard
+{
+public:
+
+    KeyboardEvdev(std::unique_ptr<EvdevReader> reader);
+
+    // Drain the events read since the previous call
+    void update() override;
+
+    bool is_key_pressed(unsigned int keycode) const override;
+    bool is_button_pressed(unsigned int button) const override;
+    const KeyMask& get_keys() const override;
+    void take_key_presses(std::vector<KeyStroke>& presses) override;
+
+    // Takes the relative pointer motion accumulated since the previous call,
+    // including the events which have not been drained by update yet
+    std::pair<int, int> take_pointer_motion();
+
+private:
+    void process_key(const EvdevEvent& evt);
+
+    std::unique_ptr<EvdevReader> reader;
+    KeyMask keys;
+    std::bitset<8> buttons;
+    std::vector<KeyStroke> key_presses;
+    int motion_x = 0, motion_y = 0;
+};
+
+KeyboardEvdev::KeyboardEvdev(std::unique_ptr<EvdevReader> r)
+    : reader(std::move(r)) {
+    key_presses.reserve(EVDEV_QUEUE_SIZE);
+}
+
+void KeyboardEvdev::update() {
+    if (reader->take_overflow())
+        logger::warn("Evdev event queue is full, input events have been dropped");
+
+    EvdevEvent evt;
+    while (reader->pop(evt)) {
+        switch (evt.type) {
+            case EV_KEY:
+                process_key(evt);
+            break;
+            case EV_REL:
+                if (evt.code == REL_X)
+                    motion_x += evt.value;
+                else if (evt.code == REL_Y)
+                    motion_y += evt.value;
+            break;
+            case EV_SYN:
+                // the kernel has dropped events, the keys which are
+                // still held follow from the reader's resync
+                keys.reset();
+                buttons.reset();
+            break;
+        }
+    }
+}
+
+void KeyboardEvdev::process_key(const EvdevEvent& evt) {
+    // value 2 is an autorepeat, which is not a new press
+    const bool is_down = evt.value != 0;
+
+    switch (evt.code) {
+        case BTN_LEFT:   buttons[Button1] = is_down; return;
+        case BTN_MIDDLE: buttons[Button2] = is_down; return;
+        case BTN_RIGHT:  buttons[Button3] = is_down; return;
+    }
+
+    const unsigned int keycode = evt.code + EVDEV_KEYCODE_OFFSET;
+    if (keycode >= keys.size())
+        return;
+
+    if (evt.value == 1 && key_presses.size() < EVDEV_QUEUE_SIZE)
+        key_presses.push_back({keycode, static_cast<unsigned long>(evt.time)});
+    keys[keycode] = is_down;
+}
+
+bool KeyboardEvdev::is_key_pressed(unsigned int keycode) const {
+    return keycode < keys.size() && keys.test(keycode);
+}
+
+bool KeyboardEvdev::is_button_pressed(unsigned int button) const {
+    return button < buttons.size() && buttons.test(button);
+}
+
+const KeyMask& KeyboardEvdev::get_keys() const {
+    return keys;
+}
+
+void KeyboardEvdev::take_key_presses(std::vector<KeyStroke>& presses) {
+    // both buffers keep their capacity, see KeyboardX11
+    presses.assign(key_presses.begin(), key_presses.end());
+    key_presses.clear();
+}
+
+std::pair<int, int> KeyboardEvdev::take_pointer_motion() {
+    // the mouse may be sampled again late in the frame
+    update();
+
+    const auto motion = std::make_pair(motion_x, motion_y);
+    motion_x = motion_y = 0;
+    return motion;
+}
+
+// Moves a virtual pointer by the relative motion of the mice. Evdev has no
+// notion of the cursor, so the position follows the motion, not the cursor
+class MouseEvdev : public IMouse
+{
+public:
+
+    // Without a display connection the pointer moves over the whole desktop
+    MouseEvdev(Display* display, KeyboardEvdev& keyboard, bool left_handed, const std::string& monitor);
+
+    std::pair<double, double> get_position() override;
+    bool is_left_button_pressed() override;
+    bool is_right_button_pressed() override;
+
+private:
+    const ScreenRect& get_screen_rect();
+
+    KeyboardEvdev& keyboard;
+    std::optional<ScreenLayout> screen;
+    ScreenRect desktop_rect;
+    bool is_left_handed;
+    double pos_x = 0, pos_y = 0;
+};
+
+MouseEvdev::MouseEvdev(Display* display, KeyboardEvdev& kbd, bool left_handed, const std::string& monitor)
+    : keyboard(kbd)
+    , is_left_handed(left_handed) {
+    if (!display) {
+        const sf::Vector2u size = sf::VideoMode::getDesktopMode().size;
+        desktop_rect.width = std::max(size.x, 1u);
+        desktop_rect.height = std::max(size.y, 1u);
+        if (!monitor.empty())
+            logger::warn("Monitors can not be selected without an X server, the mouse is mapped onto the whole desktop");
+
+        pos_x = desktop_rect.width / 2.0;
+        pos_y = desktop_rect.height / 2.0;
+        return;
+    }
+
+    screen.emplace(display, monitor);
+
+    // start where the cursor is if the X server knows it
+    Window root_ret, child_ret;
+    int root_x = 0, root_y = 0, win_x, win_y;
+    unsigned int mask;
+    const ScreenRect& rect = screen->get_rect();
+    if (XQueryPointer(display, DefaultRootWindow(display), &root_ret, &child_ret,
+                      &root_x, &root_y, &win_x, &win_y, &mask)) {
+        pos_x = root_x;
+        pos_y = root_y;
+    }
+    else {
+        pos_x = rect.x + rect.width / 2.0;
+        pos_y = rect.y + rect.height / 2.0;
+    }
+}
+
+const ScreenRect& MouseEvdev::get_screen_rect() {
+    return screen ? screen->get_rect() : desktop_rect;
+}
+
+std::pair<double, double> MouseEvdev::get_position() {
+    const ScreenRect& rect = get_screen_rect();
+    const auto motion = keyboard.take_pointer_motion();
+
+    pos_x = std::clamp(pos_x + motion.first, double(rect.x), double(rect.x + rect.width));
+    pos_y = std::clamp(pos_y + motion.second, double(rect.y), double(rect.y + rect.height));
+
+    double x = (pos_x - rect.x) / rect.width;
+    double y = (pos_y - rect.y) / rect.height;
+
+    if (is_left_handed) {
+        x = 1 - x;
+    }
+
+    return std::make_pair(x, y);
+}
+
+bool MouseEvdev::is_left_button_pressed() {
+    return keyboard.is_button_pressed(Button1);
+}
+
+bool MouseEvdev::is_right_button_pressed() {
+    return keyboard.is_button_pressed(Button3);
+}
+
+std::unique_ptr<IKeyboard> create_evdev_keyboard_handler(std::unique_ptr<EvdevReader> reader) {
+    if (!reader->is_open())
+        return nullptr;
+
+    return std::make_unique<KeyboardEvdev>(std::move(reader));
+}
+
+std::unique_ptr<IKeyboard> create_evdev_keyboard_handler() {
+    return create_evdev_keyboard_handler(std::make_unique<EvdevReader>());
+}
+
+std::unique_ptr<IMouse> create_evdev_mouse_handler(void* pdisplay, IKeyboard& keyboard, bool is_left_handed,
+                                                   const std::string& monitor) {
+    Display *display = static_cast<Display *>(pdisplay);
+    auto* evdev_keyboard = dynamic_cast<KeyboardEvdev*>(&keyboard);
+    if (!evdev_keyboard) {
+        // the pointer motion is read along with the keys
+        return create_mouse_handler(display, keyboard, is_left_handed, monitor);
+    }
+
+    return std::make_unique<MouseEvdev>(display, *evdev_keyboard, is_left_handed, monitor);
+}
+
+}
@@ -1,18 +1,33 @@
 #include "header.hpp"
 #include "input.hpp"
+#include "x11.hpp"
+#include "sync.hpp"
+#include "replay.hpp"
 #include <SFML/Window/Joystick.hpp>
-#include <SFML/Window/Keyboard.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <sstream>
 #include <iomanip>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <SFML/Window.hpp>
 
 #include <X11/Xlib.h>
+#include <X11/XKBlib.h>
 #include <X11/keysym.h>
 
-#define TOTAl_INPUT_TABLE_SIZE 256
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 #define JOYSTICK_AXIS_DEADZONE 10.0f
 #define JOYSTICK_TRIGGER_DEADZONE 3.0f
+#define SAMPLER_QUEUE_SIZE 1024
 
 namespace input {
 
@@ -25,11 +40,78 @@ sf::RectangleShape debugBackground;
 sf::Font debugFont;
 std::unique_ptr<sf::Text> debugText;
 
-static std::unique_ptr<IMouse> g_mouse;
+// input devices' state sampled at once
+struct InputSample
+{
+    KeyMask keys;
+    std::pair<double, double> mouse_pos = {0.0, 0.0};
+    bool is_left_button_pressed = false;
+    bool is_right_button_pressed = false;
+    std::chrono::steady_clock::time_point time;
+    // serial number of the next request of the sampling connection
+    unsigned long request_serial = 0;
+};
 
-IMouse& get_mouse_input() {
-    return *g_mouse;
-}
+// Samples input devices on a dedicated thread using its own display connection
+class InputSampler
+{
+public:
+
+    InputSampler(int rate, bool is_left_handed, const std::string& monitor);
+    ~InputSampler();
+
+    int get_rate() const {
+        return rate;
+    }
+
+    // Fetches the latest sample and the key presses registered
+    // since the previous call; never blocks
+    void read(InputFrame& frame);
+
+    // Fetches only the mouse position of the latest sample
+    void read_mouse(InputFrame& frame);
+
+private:
+    void run();
+
+    int rate;
+    Display* display;
+    std::unique_ptr<IKeyboard> keyboard;
+    std::unique_ptr<IMouse> mouse;
+    std::vector<KeyStroke> presses;
+    // serial number of the request of the sampler's connection at the previous read
+    unsigned long last_request_serial = 0;
+
+    // the state published last, to tell whether the new sample has changed
+    InputSample last_sample;
+
+    lockfree::TripleBuffer<InputSample> samples;
+    lockfree::SpscQueue<KeyStroke, SAMPLER_QUEUE_SIZE> key_presses;
+
+    std::atomic<bool> is_running{true};
+    std::thread thread;
+};
+
+// handlers of the main display connection, used when there is no sampler
+static std::unique_ptr<IKeyboard> g_keyboard;
+static std::unique_ptr<IMouse> g_mouse;
+static std::unique_ptr<InputSampler> g_sampler;
+// serial number of the request of the main connection at the previous frame
+static unsigned long g_last_request_serial = 0;
+// listeners of each display connection; the sampler's connection is
+// dispatched on its thread while the main thread may add listeners of its own
+static std::map<Display*, std::vector<IX11EventListener*>> x11_listeners;
+static std::mutex x11_listeners_mutex;
+static bool g_is_left_handed = false;
+static std::string g_monitor;
+static std::string g_backend;
+// the pointer motion wakes wait_for_input up, rather than only the timeout
+static bool g_is_motion_waking = false;
+static std::unique_ptr<InputRecorder> g_recorder;
+static std::unique_ptr<InputPlayer> g_player;
+static bool g_is_replay_finished = false;
+// signaled by the sampler and the evdev reader, wait_for_input polls it along with the display
+static int g_wake_fd = -1;
 
 enum JoystickInputMapRange {
     MinButton =     0,
@@ -50,72 +132,286 @@ enum JoystickInputMapRange {
     RTrigger
 };
 
-Display* dpy;
+Display* dpy = nullptr;
 
 static int _XlibErrorHandler(Display *display, XErrorEvent *event) {
     return true;
 }
 
-int INPUT_KEY_TABLE[TOTAl_INPUT_TABLE_SIZE];
+void add_x11_listener(Display* display, IX11EventListener* listener) {
+    std::lock_guard<std::mutex> lock(x11_listeners_mutex);
+    x11_listeners[display].push_back(listener);
+}
 
-bool init(int width, int height, bool is_left_handed) {
-    for (int i = 0; i < TOTAl_INPUT_TABLE_SIZE; i++) {
-        if (i >= 48 && i <= 57) {           // number
-            INPUT_KEY_TABLE[i] = i - 48 + (int)sf::Keyboard::Key::Num0;
-        } else if (i >= 65 && i <= 90) {    // english alphabet
-            INPUT_KEY_TABLE[i] = i - 65 + (int)sf::Keyboard::Key::A;
-        } else if (i >= 96 && i <= 105) {   // numpad
-            INPUT_KEY_TABLE[i] = i - 96 + (int)sf::Keyboard::Key::Numpad0;
-        } else if (i >= 112 && i <= 126) {  // function
-            INPUT_KEY_TABLE[i] = i - 112 + (int)sf::Keyboard::Key::F1;
-        } else {
-            INPUT_KEY_TABLE[i] = (int)sf::Keyboard::Key::Unknown;
+void remove_x11_listener(Display* display, IX11EventListener* listener) {
+    std::lock_guard<std::mutex> lock(x11_listeners_mutex);
+    auto it = x11_listeners.find(display);
+    if (it == x11_listeners.end())
+        return;
+
+    auto& listeners = it->second;
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+    // a closed connection's address may be reused by the next one
+    if (listeners.empty())
+        x11_listeners.erase(it);
+}
+
+static void dispatch_x11_events(Display* display) {
+    // Dispatch all pending events of the connection to its backends
+    while (XPending(display)) {
+        XEvent evt;
+        XNextEvent(display, &evt);
+
+        std::lock_guard<std::mutex> lock(x11_listeners_mutex);
+        auto it = x11_listeners.find(display);
+        if (it == x11_listeners.end())
+            continue;
+        for (auto* listener : it->second)
+            listener->process_x11_event(evt);
+    }
+}
+
+// Notices the changes of the keyboard mapping on the main connection,
+// which the key bindings are resolved with
+class KeymapListener : public IX11EventListener
+{
+public:
+
+    explicit KeymapListener(Display* display);
+    ~KeymapListener();
+
+    void process_x11_event(XEvent& evt) override;
+
+    // Returns true if the mapping has changed since the previous call
+    bool take_change() {
+        return std::exchange(is_changed, false);
+    }
+
+private:
+    Display* dpy;
+    int xkb_event_base = -1;
+    bool is_changed = false;
+};
+
+KeymapListener::KeymapListener(Display* display)
+    : dpy(display) {
+    // the core MappingNotify is sent to every client, the XKB events have to be selected
+    int opcode, error_base, major = XkbMajorVersion, minor = XkbMinorVersion;
+    if (XkbQueryExtension(dpy, &opcode, &xkb_event_base, &error_base, &major, &minor)) {
+        const unsigned long mask = XkbNewKeyboardNotifyMask | XkbMapNotifyMask;
+        XkbSelectEvents(dpy, XkbUseCoreKbd, mask, mask);
+    }
+    else {
+        xkb_event_base = -1;
+    }
+
+    add_x11_listener(dpy, this);
+}
+
+KeymapListener::~KeymapListener() {
+    remove_x11_listener(dpy, this);
+    if (xkb_event_base >= 0) {
+        const unsigned long mask = XkbNewKeyboardNotifyMask | XkbMapNotifyMask;
+        XkbSelectEvents(dpy, XkbUseCoreKbd, mask, 0);
+    }
+}
+
+void KeymapListener::process_x11_event(XEvent& evt) {
+    if (evt.type == MappingNotify) {
+        if (evt.xmapping.request != MappingPointer) {
+            XRefreshKeyboardMapping(&evt.xmapping);
+            is_changed = true;
+        }
+        return;
+    }
+
+    if (xkb_event_base < 0 || evt.type != xkb_event_base)
+        return;
+
+    auto* xkb_evt = reinterpret_cast<XkbEvent*>(&evt);
+    if (xkb_evt->any.xkb_type == XkbMapNotify) {
+        XkbRefreshKeyboardMapping(&xkb_evt->map);
+        is_changed = true;
+    }
+    // switching between keyboards of the same keycodes changes nothing
+    else if (xkb_evt->any.xkb_type == XkbNewKeyboardNotify
+             && (xkb_evt->new_kbd.changed & XkbNKN_KeycodesMask)) {
+        is_changed = true;
+    }
+}
+
+static std::unique_ptr<KeymapListener> g_keymap_listener;
+
+// Creates the handlers of the configured backend bound to the display
+static void create_handlers(Display* display, bool is_left_handed, const std::string& monitor,
+                            bool is_motion_selected,
+                            std::unique_ptr<IKeyboard>& keyboard, std::unique_ptr<IMouse>& mouse) {
+    if (g_backend == "evdev") {
+        keyboard = create_evdev_keyboard_handler();
+        if (keyboard) {
+            mouse = create_evdev_mouse_handler(display, *keyboard, is_left_handed, monitor);
+            return;
+        }
+        logger::info("Falling back to the X11 input backend");
+    }
+
+    keyboard = create_keyboard_handler(display, is_motion_selected);
+    mouse = create_mouse_handler(display, *keyboard, is_left_handed, monitor);
+}
+
+static void sample_devices(Display* display, IKeyboard& keyboard, IMouse& mouse, InputSample& sample) {
+    dispatch_x11_events(display);
+    keyboard.update();
+
+    sample.keys = keyboard.get_keys();
+    sample.mouse_pos = mouse.get_position();
+    sample.is_left_button_pressed = mouse.is_left_button_pressed();
+    sample.is_right_button_pressed = mouse.is_right_button_pressed();
+    sample.time = std::chrono::steady_clock::now();
+    sample.request_serial = NextRequest(display);
+}
+
+// Copies the sample into the frame; the requests are counted from
+// the serial of the previous frame on the same connection
+static void copy_sample(const InputSample& sample, unsigned long& last_request_serial, InputFrame& frame) {
+    // nothing is counted before the first sample of the connection is taken
+    if (sample.request_serial < last_request_serial) {
+        frame.x_requests = 0;
+    }
+    else {
+        frame.x_requests = sample.request_serial - last_request_serial;
+        last_request_serial = sample.request_serial;
+    }
+
+    frame.keys = sample.keys;
+    frame.mouse_pos = sample.mouse_pos;
+    frame.is_left_button_pressed = sample.is_left_button_pressed;
+    frame.is_right_button_pressed = sample.is_right_button_pressed;
+    frame.sample_time = sample.time;
+    frame.mouse_time = sample.time;
+}
+
+InputSampler::InputSampler(int r, bool is_left_handed, const std::string& monitor)
+    : rate(r) {
+    // Xlib connections must not be shared between threads,
+    // so the sampler gets its own one; it polls the devices, the motion
+    // events would only be decoded and thrown away
+    display = XOpenDisplay(NULL);
+    create_handlers(display, is_left_handed, monitor, false, keyboard, mouse);
+    presses.reserve(SAMPLER_QUEUE_SIZE);
+    last_request_serial = NextRequest(display);
+
+    thread = std::thread(&InputSampler::run, this);
+}
+
+InputSampler::~InputSampler() {
+    is_running = false;
+    thread.join();
+
+    mouse.reset();
+    keyboard.reset();
+    XCloseDisplay(display);
+}
+
+void InputSampler::run() {
+    using clock = std::chrono::steady_clock;
+    const auto period = std::chrono::microseconds(1000000 / rate);
+    auto deadline = clock::now();
+
+    while (is_running.load(std::memory_order_relaxed)) {
+        InputSample& sample = samples.write_buffer();
+        sample_devices(display, *keyboard, *mouse, sample);
+
+        // the presses are queued before the sample is published,
+        // so a reader never sees a key state without its presses
+        keyboard->take_key_presses(presses);
+        for (const auto& press : presses)
+            key_presses.push(press);
+
+        const bool is_changed = !presses.empty() || sample.keys != last_sample.keys
+            || sample.mouse_pos != last_sample.mouse_pos
+            || sample.is_left_button_pressed != last_sample.is_left_button_pressed
+            || sample.is_right_button_pressed != last_sample.is_right_button_pressed;
+        last_sample = sample;
+
+        samples.publish();
+        if (is_changed)
+            notify_input();
+
+        deadline += period;
+        const auto now = clock::now();
+        if (deadline < now) {
+            // a device has stalled, do not try to catch up
+            deadline = now;
         }
+        std::this_thread::sleep_until(deadline);
+    }
+}
+
+void InputSampler::read(InputFrame& frame) {
+    samples.update();
+    copy_sample(samples.read_buffer(), last_request_serial, frame);
+
+    frame.key_presses.clear();
+    KeyStroke press;
+    while (key_presses.pop(press))
+        frame.key_presses.push_back(press);
+}
+
+void InputSampler::read_mouse(InputFrame& frame) {
+    // the keys of the sample are copied by the next read
+    samples.update();
+    const InputSample& sample = samples.read_buffer();
+    frame.mouse_pos = sample.mouse_pos;
+    frame.mouse_time = sample.time;
+}
+
+// Recreates the input handlers, on a separate thread if the rate is set
+static void restart_handlers(int rate) {
+    // only one set of handlers may listen to the events at a time
+    g_sampler.reset();
+    g_mouse.reset();
+    g_keyboard.reset();
+
+    if (rate > 0) {
+        // the handlers of the main connection have deselected their events,
+        // drop the ones which arrived before, since nobody reads them anymore
+        if (dpy)
+            XSync(dpy, True);
+        g_sampler = std::make_unique<InputSampler>(rate, g_is_left_handed, g_monitor);
+    }
+    else {
+        create_handlers(dpy, g_is_left_handed, g_monitor, g_is_motion_waking, g_keyboard, g_mouse);
+        g_last_request_serial = NextRequest(dpy);
     }
+}
 
-    INPUT_KEY_TABLE[27] = (int)sf::Keyboard::Key::Escape;
-    INPUT_KEY_TABLE[17] = (int)sf::Keyboard::Key::LControl;
-    INPUT_KEY_TABLE[16] = (int)sf::Keyboard::Key::LShift;
-    INPUT_KEY_TABLE[18] = (int)sf::Keyboard::Key::LAlt;
-    INPUT_KEY_TABLE[17] = (int)sf::Keyboard::Key::RControl;
-    INPUT_KEY_TABLE[16] = (int)sf::Keyboard::Key::RShift;
-    INPUT_KEY_TABLE[18] = (int)sf::Keyboard::Key::RAlt;
-    INPUT_KEY_TABLE[93] = (int)sf::Keyboard::Key::Menu;
-    INPUT_KEY_TABLE[219] = (int)sf::Keyboard::Key::LBracket;
-    INPUT_KEY_TABLE[221] = (int)sf::Keyboard::Key::RBracket;
-    INPUT_KEY_TABLE[186] = (int)sf::Keyboard::Key::Semicolon;
-    INPUT_KEY_TABLE[188] = (int)sf::Keyboard::Key::Comma;
-    INPUT_KEY_TABLE[190] = (int)sf::Keyboard::Key::Period;
-    INPUT_KEY_TABLE[222] = (int)sf::Keyboard::Key::Apostrophe;
-    INPUT_KEY_TABLE[191] = (int)sf::Keyboard::Key::Slash;
-    INPUT_KEY_TABLE[220] = (int)sf::Keyboard::Key::Backslash;
-    INPUT_KEY_TABLE[192] = (int)sf::Keyboard::Key::Grave;
-    INPUT_KEY_TABLE[187] = (int)sf::Keyboard::Key::Equal;
-    INPUT_KEY_TABLE[189] = (int)sf::Keyboard::Key::Hyphen;
-    INPUT_KEY_TABLE[32] = (int)sf::Keyboard::Key::Space;
-    INPUT_KEY_TABLE[13] = (int)sf::Keyboard::Key::Enter;
-    INPUT_KEY_TABLE[8] = (int)sf::Keyboard::Key::Backspace;
-    INPUT_KEY_TABLE[9] = (int)sf::Keyboard::Key::Tab;
-    INPUT_KEY_TABLE[33] = (int)sf::Keyboard::Key::PageUp;
-    INPUT_KEY_TABLE[34] = (int)sf::Keyboard::Key::PageDown;
-    INPUT_KEY_TABLE[35] = (int)sf::Keyboard::Key::End;
-    INPUT_KEY_TABLE[36] = (int)sf::Keyboard::Key::Home;
-    INPUT_KEY_TABLE[45] = (int)sf::Keyboard::Key::Insert;
-    INPUT_KEY_TABLE[46] = (int)sf::Keyboard::Key::Delete;
-    INPUT_KEY_TABLE[107] = (int)sf::Keyboard::Key::Add;
-    INPUT_KEY_TABLE[109] = (int)sf::Keyboard::Key::Subtract;
-    INPUT_KEY_TABLE[106] = (int)sf::Keyboard::Key::Multiply;
-    INPUT_KEY_TABLE[111] = (int)sf::Keyboard::Key::Divide;
-    INPUT_KEY_TABLE[37] = (int)sf::Keyboard::Key::Left;
-    INPUT_KEY_TABLE[39] = (int)sf::Keyboard::Key::Right;
-    INPUT_KEY_TABLE[38] = (int)sf::Keyboard::Key::Up;
-    INPUT_KEY_TABLE[40] = (int)sf::Keyboard::Key::Down;
-    INPUT_KEY_TABLE[19] = (int)sf::Keyboard::Key::Pause;
+void init_threads() {
+    XInitThreads();
+}
 
+bool init(int width, int height, bool is_left_handed) {
     // Set x11 error handler
     XSetErrorHandler(_XlibErrorHandler);
 
+    // the sampler is restarted with the new settings
+    const int sampling_rate = g_sampler ? g_sampler->get_rate() : 0;
+    g_sampler.reset();
+    g_is_left_handed = is_left_handed;
+
+    // release the handlers bound to the previous connection
+    if (dpy) {
+        g_mouse.reset();
+        g_keyboard.reset();
+        g_keymap_listener.reset();
+        XCloseDisplay(dpy);
+    }
+
     dpy = XOpenDisplay(NULL);
+    g_keymap_listener = std::make_unique<KeymapListener>(dpy);
+
+    if (g_wake_fd < 0)
+        g_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
 
     // loading font
     debugFont = data::get_debug_font();
@@ -130,56 +426,165 @@ bool init(int width, int height, bool is_left_handed) {
     debugText->setPosition({10.0f, 4.0f});
     debugText->setString(debugMessage);
 
-    g_mouse = create_mouse_handler(dpy, is_left_handed);
+    restart_handlers(sampling_rate);
 
     return true;
 }
 
-sf::Keyboard::Key ascii_to_key(int key_code) {
-    if (key_code < 0 || key_code >= TOTAl_INPUT_TABLE_SIZE) {
-        // out of range
-        return sf::Keyboard::Key::Unknown;
-    } else {
-        return (sf::Keyboard::Key)(INPUT_KEY_TABLE[key_code]);
-    }
+void set_sampling_rate(int rate) {
+    const int current_rate = g_sampler ? g_sampler->get_rate() : 0;
+    if (rate == current_rate)
+        return;
+
+    restart_handlers(rate);
+}
+
+void set_backend(const std::string& backend) {
+    if (backend == g_backend)
+        return;
+
+    g_backend = backend;
+    restart_handlers(g_sampler ? g_sampler->get_rate() : 0);
+}
+
+void set_monitor(const std::string& monitor) {
+    if (monitor == g_monitor)
+        return;
+
+    g_monitor = monitor;
+    restart_handlers(g_sampler ? g_sampler->get_rate() : 0);
+}
+
+void set_motion_waking(bool is_waking) {
+    if (is_waking == g_is_motion_waking)
+        return;
+
+    g_is_motion_waking = is_waking;
+    restart_handlers(g_sampler ? g_sampler->get_rate() : 0);
 }
 
-// for some special cases of num dot and such
-bool is_pressed_fallback(int key_code) {
-    // code snippet from SFML
-    KeyCode keycode = XKeysymToKeycode(dpy, key_code);
-    if (keycode != 0) {
-        char keys[32];
-        XQueryKeymap(dpy, keys);
-        return (keys[keycode / 8] & (1 << (keycode % 8))) != 0;
+// Maps virtual key codes used by the original config format onto X keysyms
+static std::vector<KeySym> ascii_to_keysyms(int key_code) {
+    if (key_code >= 48 && key_code <= 57) {           // number
+        return { KeySym(key_code - 48 + XK_0) };
+    } else if (key_code >= 65 && key_code <= 90) {    // english alphabet
+        return { KeySym(key_code - 65 + XK_a) };
+    } else if (key_code >= 96 && key_code <= 105) {   // numpad
+        return { KeySym(key_code - 96 + XK_KP_0) };
+    } else if (key_code >= 112 && key_code <= 126) {  // function
+        return { KeySym(key_code - 112 + XK_F1) };
     }
-    else {
-        return false;
+
+    switch (key_code) {
+        case 8:   return { XK_BackSpace };
+        case 9:   return { XK_Tab };
+        case 13:  return { XK_Return };
+        case 16:  return { XK_Shift_L, XK_Shift_R };
+        case 17:  return { XK_Control_L, XK_Control_R };
+        case 18:  return { XK_Alt_L, XK_Alt_R };
+        case 19:  return { XK_Pause };
+        case 27:  return { XK_Escape };
+        case 32:  return { XK_space };
+        case 33:  return { XK_Page_Up };
+        case 34:  return { XK_Page_Down };
+        case 35:  return { XK_End };
+        case 36:  return { XK_Home };
+        case 37:  return { XK_Left };
+        case 38:  return { XK_Up };
+        case 39:  return { XK_Right };
+        case 40:  return { XK_Down };
+        case 45:  return { XK_Insert };
+        case 46:  return { XK_Delete };
+        case 93:  return { XK_Menu };
+        case 106: return { XK_KP_Multiply };
+        case 107: return { XK_KP_Add };
+        case 109: return { XK_KP_Subtract };
+        case 111: return { XK_KP_Divide };
+        case 186: return { XK_semicolon };
+        case 187: return { XK_equal };
+        case 188: return { XK_comma };
+        case 189: return { XK_minus };
+        case 190: return { XK_period };
+        case 191: return { XK_slash };
+        case 192: return { XK_grave };
+        case 219: return { XK_bracketleft };
+        case 220: return { XK_backslash };
+        case 221: return { XK_bracketright };
+        case 222: return { XK_apostrophe };
     }
+
+    return {};
 }
 
-bool is_pressed(int key_code) {
-    if (key_code == 16) {
-        return sf::Keyboard::isKeyPressed(sf::Keyboard::Key::LShift)
-            || sf::Keyboard::isKeyPressed(sf::Keyboard::Key::RShift);
-    } else if (key_code == 17) {
-        return sf::Keyboard::isKeyPressed(sf::Keyboard::Key::LControl)
-            || sf::Keyboard::isKeyPressed(sf::Keyboard::Key::RControl);
-    } else {
-        sf::Keyboard::Key selected = ascii_to_key(key_code);
-        if (selected != sf::Keyboard::Key::Unknown) {
-            return sf::Keyboard::isKeyPressed(selected);
-        } else {
-            return is_pressed_fallback(key_code);
+// Collects all keycodes which produce the keysym without modifiers or with shift
+static void add_keysym_keycodes(KeyMask& mask, KeySym keysym) {
+    int min_keycode, max_keycode;
+    XDisplayKeycodes(dpy, &min_keycode, &max_keycode);
+
+    bool is_found = false;
+    for (int kc = min_keycode; kc <= max_keycode && kc < (int)mask.size(); ++kc) {
+        for (unsigned int level = 0; level < 2; ++level) {
+            if (XkbKeycodeToKeysym(dpy, kc, 0, level) == keysym) {
+                mask.set(kc);
+                is_found = true;
+            }
         }
     }
+
+    if (!is_found) {
+        // the keysym may be bound to another group or level
+        KeyCode keycode = XKeysymToKeycode(dpy, keysym);
+        if (keycode != 0)
+            mask.set(keycode);
+    }
+}
+
+KeyMask resolve_key_code(int key_code) {
+    KeyMask mask;
+    auto keysyms = ascii_to_keysyms(key_code);
+
+    if (keysyms.empty()) {
+        // for some special cases of num dot and such
+        // the key code is treated as a keysym
+        keysyms.push_back(key_code);
+    }
+
+    for (auto keysym : keysyms)
+        add_keysym_keycodes(mask, keysym);
+
+    if (mask.none())
+        logger::warn("Key code " + std::to_string(key_code) + " is not found on the keyboard");
+
+    return mask;
+}
+
+bool take_keymap_change() {
+    return g_keymap_listener && g_keymap_listener->take_change();
+}
+
+std::optional<KeyMask> resolve_key_name(const std::string& name) {
+    KeySym keysym = XStringToKeysym(name.c_str());
+    if (keysym == NoSymbol)
+        return std::nullopt;
+
+    KeyMask mask;
+    add_keysym_keycodes(mask, keysym);
+
+    if (mask.none())
+        logger::warn("Key " + name + " is not found on the keyboard");
+
+    return mask;
+}
+
+bool is_pressed(const InputFrame& frame, const KeyMask& key) {
+    return (frame.latched_keys & key).any();
 }
 
 bool is_joystick_connected() {
     return sf::Joystick::isConnected(0);
 }
 
-bool is_joystick_pressed(int key_code) {
+static bool read_joystick_state(int key_code) {
     int id = 0;
     last_joystick_keycode = key_code;
 
@@ -271,9 +676,140 @@ bool is_joystick_pressed(int key_code) {
     return false;
 }
 
-void drawDebugPanel(sf::RenderWindow& window) {
+bool is_joystick_pressed(const InputFrame& frame, const JoystickMask& codes) {
+    return (frame.joystick & codes) == codes;
+}
+
+void notify_input() {
+    const uint64_t value = 1;
+    if (g_wake_fd >= 0 && write(g_wake_fd, &value, sizeof(value)) < 0) {
+        // the counter is saturated, the waiting loop is woken up anyway
+    }
+}
+
+void capture_frame(InputFrame& frame) {
+    // the input arriving from now on is not in this frame, so it wakes the loop up again
+    if (g_wake_fd >= 0) {
+        uint64_t value;
+        while (read(g_wake_fd, &value, sizeof(value)) > 0) {}
+    }
+
+    if (g_player) {
+        // the recording replaces all input devices
+        if (!g_player->read(frame))
+            g_is_replay_finished = true;
+        return;
+    }
+
+    if (g_sampler) {
+        // the main connection carries only the keymap changes then
+        dispatch_x11_events(dpy);
+        g_sampler->read(frame);
+    }
+    else {
+        InputSample sample;
+        sample_devices(dpy, *g_keyboard, *g_mouse, sample);
+        copy_sample(sample, g_last_request_serial, frame);
+        g_keyboard->take_key_presses(frame.key_presses);
+    }
+
+    // latch the keys which have been pressed and released between frames
+    frame.latched_keys = frame.keys;
+    for (const auto& press : frame.key_presses)
+        frame.latched_keys.set(press.keycode);
+
+    // sweep all joystick buttons and axes at once; joysticks are always
+    // read here, since SFML updates their state in the window's event loop
+    frame.joystick.reset();
+    if (is_joystick_connected()) {
+        for (int code = MinButton; code <= RTrigger; ++code)
+            frame.joystick[code] = read_joystick_state(code);
+    }
+
+    if (g_recorder)
+        g_recorder->write(frame);
+}
+
+void latch_mouse(InputFrame& frame) {
+    if (g_player) {
+        // the recorded position is not sampled again
+        return;
+    }
+
+    if (g_sampler) {
+        g_sampler->read_mouse(frame);
+    }
+    else {
+        frame.mouse_pos = g_mouse->get_position();
+        frame.mouse_time = std::chrono::steady_clock::now();
+    }
+}
+
+void wait_for_input(std::chrono::microseconds timeout) {
+    if (g_player) {
+        // the replay has no events to wait for
+        std::this_thread::sleep_for(timeout);
+        return;
+    }
+
+    pollfd pfds[2] = {};
+    nfds_t count = 0;
+
+    if (g_wake_fd >= 0) {
+        pfds[count].fd = g_wake_fd;
+        pfds[count].events = POLLIN;
+        ++count;
+    }
+
+    // the sampler reads its own connection
+    if (!g_sampler && dpy) {
+        // the events may have been read from the socket already
+        if (XPending(dpy))
+            return;
+
+        pfds[count].fd = ConnectionNumber(dpy);
+        pfds[count].events = POLLIN;
+        ++count;
+    }
+
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    timespec ts;
+    ts.tv_sec = seconds.count();
+    ts.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds).count();
+    ppoll(pfds, count, &ts, nullptr);
+}
+
+bool start_recording(const std::string& path) {
+    auto recorder = std::make_unique<InputRecorder>();
+    if (!recorder->open(path))
+        return false;
+
+    g_recorder = std::move(recorder);
+    logger::info("Recording input into " + path);
+    return true;
+}
+
+bool start_replay(const std::string& path, bool is_paced) {
+    auto player = std::make_unique<InputPlayer>();
+    if (!player->open(path, is_paced))
+        return false;
+
+    g_player = std::move(player);
+    g_is_replay_finished = false;
+    logger::info("Replaying input from " + path);
+    return true;
+}
+
+bool is_replay_finished() {
+    return g_is_replay_finished;
+}
+
+void drawDebugPanel(sf::RenderWindow& window, const InputFrame& frame, const std::string& frame_info) {
+    const std::string requests = frame_info
+        + "X requests per frame : " + std::to_string(frame.x_requests) + "\n";
+
     if (!is_joystick_connected()) {
-        debugText->setString("No joystick found...");
+        debugText->setString(requests + "No joystick found...");
         window.draw(debugBackground);
         window.draw(*debugText);
         return;
@@ -282,6 +818,7 @@ void drawDebugPanel(sf::RenderWindow& window) {
     int joy_id = 0;
 
     std::stringstream result;
+    result << requests;
     sf::Joystick::Identification info = sf::Joystick::getIdentification(joy_id);
 
     result << "Joystick connected : " << info.name.toAnsiString() << std::endl;
@@ -343,7 +880,18 @@ void drawDebugPanel(sf::RenderWindow& window) {
 }
 
 void cleanup() {
+    g_recorder.reset();
+    g_player.reset();
+    g_sampler.reset();
+    g_mouse.reset();
+    g_keyboard.reset();
+    g_keymap_listener.reset();
     XCloseDisplay(dpy);
+
+    if (g_wake_fd >= 0) {
+        close(g_wake_fd);
+        g_wake_fd = -1;
+    }
 }
 
 };
@@ -0,0 +1,223 @@
+#include <header.hpp>
+#include <x11.hpp>
+extern "C" {
+#include <X11/Xlib.h>
+#include <X11/extensions/XInput2.h>
+}
+
+#include <bitset>
+#include <chrono>
+
+#define MAX_QUEUED_KEY_PRESSES 1024
+
+namespace input
+{
+
+class KeyboardX11 : public IKeyboard
+{
+public:
+
+    KeyboardX11(Display* display);
+
+    // Query the whole keyboard and pointer state once per frame
+    void update() override;
+
+    bool is_key_pressed(unsigned int keycode) const override;
+    bool is_button_pressed(unsigned int button) const override;
+    const KeyMask& get_keys() const override;
+    void take_key_presses(std::vector<KeyStroke>& presses) override;
+
+protected:
+    void query_state();
+    void push_key_press(unsigned int keycode, unsigned long time);
+
+    Display* dpy;
+    // X keycodes and button numbers are both limited to a byte
+    KeyMask keys;
+    std::bitset<256> buttons;
+    // presses registered since the last call of take_key_presses
+    std::vector<KeyStroke> key_presses;
+};
+
+KeyboardX11::KeyboardX11(Display* display)
+    : dpy(display) {
+    key_presses.reserve(MAX_QUEUED_KEY_PRESSES);
+}
+
+void KeyboardX11::update() {
+    query_state();
+}
+
+bool KeyboardX11::is_key_pressed(unsigned int keycode) const {
+    return keycode < keys.size() && keys.test(keycode);
+}
+
+bool KeyboardX11::is_button_pressed(unsigned int button) const {
+    return button < buttons.size() && buttons.test(button);
+}
+
+const KeyMask& KeyboardX11::get_keys() const {
+    return keys;
+}
+
+void KeyboardX11::take_key_presses(std::vector<KeyStroke>& presses) {
+    // copy rather than swap the buffers, so that both keep their capacity
+    // and no memory is allocated in the steady state
+    presses.assign(key_presses.begin(), key_presses.end());
+    key_presses.clear();
+}
+
+void KeyboardX11::push_key_press(unsigned int keycode, unsigned long time) {
+    // if nobody takes the presses, drop the new ones; the key state is still tracked
+    if (key_presses.size() < MAX_QUEUED_KEY_PRESSES)
+        key_presses.push_back({keycode, time});
+}
+
+void KeyboardX11::query_state() {
+    char keymap[32];
+    XQueryKeymap(dpy, keymap);
+
+    KeyMask new_keys;
+    for (size_t i = 0; i < new_keys.size(); ++i) {
+        new_keys[i] = (keymap[i / 8] & (1 << (i % 8))) != 0;
+    }
+
+    // there are no events while polling, so report the keys
+    // which went down since the previous query as presses
+    const KeyMask pressed = new_keys & ~keys;
+    if (pressed.any()) {
+        using namespace std::chrono;
+        const auto now = duration_cast<milliseconds>(steady_clock::now().time_since_epoch());
+        for (size_t i = 0; i < pressed.size(); ++i) {
+            if (pressed.test(i))
+                push_key_press(i, now.count());
+        }
+    }
+    keys = new_keys;
+
+    Window root_ret, child_ret;
+    int root_x, root_y, win_x, win_y;
+    unsigned int mask = 0;
+    XQueryPointer(dpy, DefaultRootWindow(dpy), &root_ret, &child_ret,
+                  &root_x, &root_y, &win_x, &win_y, &mask);
+
+    buttons.reset();
+    buttons[Button1] = (mask & Button1Mask) != 0;
+    buttons[Button2] = (mask & Button2Mask) != 0;
+    buttons[Button3] = (mask & Button3Mask) != 0;
+    buttons[Button4] = (mask & Button4Mask) != 0;
+    buttons[Button5] = (mask & Button5Mask) != 0;
+}
+
+class KeyboardXi2 : public KeyboardX11, public IX11EventListener
+{
+public:
+
+    KeyboardXi2(Display* display, int opcode, bool is_motion_selected);
+    ~KeyboardXi2();
+
+    // The state is maintained from the event stream, nothing to query here
+    void update() override {}
+
+    void process_x11_event(XEvent& evt) override;
+
+private:
+    int xi_opcode;
+};
+
+KeyboardXi2::KeyboardXi2(Display* display, int opcode, bool is_motion_selected)
+    : KeyboardX11(display)
+    , xi_opcode(opcode) {
+    // Raw events are delivered to the root window only, regardless of
+    // which window is focused or whether the input is grabbed by someone
+    unsigned char mask_bits[XIMaskLen(XI_LASTEVENT)] = {};
+    XISetMask(mask_bits, XI_RawKeyPress);
+    XISetMask(mask_bits, XI_RawKeyRelease);
+    XISetMask(mask_bits, XI_RawButtonPress);
+    XISetMask(mask_bits, XI_RawButtonRelease);
+    // the motion itself is read by the mouse handler, the events only
+    // wake up the render loop waiting for input on the connection
+    if (is_motion_selected)
+        XISetMask(mask_bits, XI_RawMotion);
+
+    XIEventMask mask;
+    mask.deviceid = XIAllMasterDevices;
+    mask.mask_len = sizeof(mask_bits);
+    mask.mask = mask_bits;
+    XISelectEvents(dpy, DefaultRootWindow(dpy), &mask, 1);
+
+    // Events only report changes, so the keys which are already
+    // held down have to be read from the server once
+    query_state();
+    key_presses.clear();
+
+    add_x11_listener(dpy, this);
+}
+
+KeyboardXi2::~KeyboardXi2() {
+    remove_x11_listener(dpy, this);
+
+    // the connection may outlive the handler, so deselect the raw events,
+    // otherwise they are queued on it with nobody reading them
+    unsigned char mask_bits[XIMaskLen(XI_LASTEVENT)] = {};
+    XIEventMask mask;
+    mask.deviceid = XIAllMasterDevices;
+    mask.mask_len = sizeof(mask_bits);
+    mask.mask = mask_bits;
+    XISelectEvents(dpy, DefaultRootWindow(dpy), &mask, 1);
+}
+
+void KeyboardXi2::process_x11_event(XEvent& evt) {
+    XGenericEventCookie& cookie = evt.xcookie;
+    // the motion events have done their job by waking the render loop up
+    if (cookie.type != GenericEvent || cookie.extension != xi_opcode || cookie.evtype == XI_RawMotion)
+        return;
+
+    if (!XGetEventData(dpy, &cookie))
+        return;
+
+    const auto* raw = static_cast<const XIRawEvent*>(cookie.data);
+    const unsigned int detail = raw->detail;
+
+    switch (cookie.evtype) {
+        case XI_RawKeyPress:
+            if (detail < keys.size()) {
+                keys[detail] = true;
+                push_key_press(detail, raw->time);
+            }
+        break;
+        case XI_RawKeyRelease:
+            if (detail < keys.size())
+                keys[detail] = false;
+        break;
+        case XI_RawButtonPress:
+        case XI_RawButtonRelease:
+            if (detail < buttons.size())
+                buttons[detail] = cookie.evtype == XI_RawButtonPress;
+        break;
+    }
+
+    XFreeEventData(dpy, &cookie);
+}
+
+std::unique_ptr<IKeyboard> create_keyboard_handler(void* pdisplay, bool is_motion_selected) {
+    Display *display = static_cast<Display *>(pdisplay);
+    int xi_opcode, xi_event, xi_error;
+
+    if (!XQueryExtension(display, "XInputExtension", &xi_opcode, &xi_event, &xi_error)) {
+        logger::info("XInput extension is not available, falling back to keyboard polling");
+        return std::make_unique<KeyboardX11>(display);
+    }
+
+    // XI 2.1 is required to receive raw events while the input is grabbed,
+    // but 2.0 is still usable otherwise
+    int major = 2, minor = 2;
+    if (XIQueryVersion(display, &major, &minor) != Success) {
+        logger::info("XInput2 is not supported by the X server, falling back to keyboard polling");
+        return std::make_unique<KeyboardX11>(display);
+    }
+
+    return std::make_unique<KeyboardXi2>(display, xi_opcode, is_motion_selected);
+}
+
+}
@@ -1,14 +1,42 @@
 #include "cat.hpp"
 #include "header.hpp"
 #include "logger.hpp"
+#include "pacer.hpp"
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <memory>
+#include <optional>
+#include <sstream>
+
+// Describes the pacing of the latest frames for the debug panel
+static std::string describe_frame_stats(const timing::FramePacer& pacer) {
+    const timing::FrameStats stats = pacer.get_stats();
+    std::stringstream result;
+
+    if (pacer.is_vsync())
+        result << "Frame rate : vsync";
+    else if (pacer.get_rate() > 0)
+        result << "Frame rate : " << pacer.get_rate() << " Hz";
+    else
+        result << "Frame rate : unlimited";
+
+    result << ", frame time " << stats.mean_interval.count() << " us"
+           << ", jitter " << stats.jitter.count() << " us"
+           << " (max " << stats.max_jitter.count() << " us)"
+           << ", late frames " << stats.late_frames << "/" << stats.frames << "\n"
+           << "Mouse to present latency : " << stats.mean_latency.count() << " us"
+           << " (max " << stats.max_latency.count() << " us)\n";
+    return result.str();
+}
 
 int main(int argc, char ** argv) {
     // initialize basic logging
     logger::GlobalLogger::init();
 
+    // input may be sampled on a separate thread
+    input::init_threads();
+
     if(!data::init()) {
         logger::error("Fatal error has occured during data initialization");
         return EXIT_FAILURE;
@@ -18,7 +46,9 @@ int main(int argc, char ** argv) {
     // initially create window with default size
     sf::Vector2u window_size = data::g_window_default_size;
     window.create(sf::VideoMode(window_size), "Bongo Cat", sf::Style::Titlebar | sf::Style::Close);
-    window.setFramerateLimit(MAX_FRAMERATE);
+
+    // presents the frames at the configured rate
+    timing::FramePacer pacer;
 
     // initialize input
     if (!input::init(window_size.x, window_size.y)) {
@@ -37,6 +67,8 @@ int main(int argc, char ** argv) {
     bool try_reload_config = true;
     bool do_show_input_debug = false;
     bool do_show_debug_overlay = false;
+    // the window content is out of date and has to be rendered
+    bool is_dirty = true;
     
     // load config file
     data::ConfigFile config_file;
@@ -45,11 +77,35 @@ int main(int argc, char ** argv) {
         return EXIT_FAILURE;
     }
 
+    if (config_file.get_record_path() && !input::start_recording(*config_file.get_record_path()))
+        return EXIT_FAILURE;
+
+    const bool is_replay = config_file.get_replay_path().has_value();
+    if (is_replay) {
+        if (!input::start_replay(*config_file.get_replay_path(), !config_file.is_replay_unpaced()))
+            return EXIT_FAILURE;
+    }
+    const bool is_unpaced = is_replay && config_file.is_replay_unpaced();
+
+    // frame time statistics of a replay
+    sf::Clock frame_clock;
+    sf::Time replay_total_time, replay_max_frame_time;
+    unsigned int replay_frames = 0;
+
     data::Settings settings;
     std::unique_ptr<cats::ICat> cat;
     std::vector<std::string> modes;
     auto mode = modes.cend();
     sf::RenderStates rstates;
+    // the cat is rendered into the scene at a lower resolution than
+    // the window's if one is configured, then scaled to the window
+    std::optional<sf::RenderTexture> scene;
+    sf::RenderStates scene_rstates;
+    // how the cat is drawn, into the scene or directly into the window
+    cats::RenderParameters render_params;
+    input::InputFrame input_frame;
+    bool is_render_on_change = false;
+    bool is_mouse_late_latched = false;
 
     auto reload_config = [&]() {
         // try to load config file
@@ -63,11 +119,6 @@ int main(int argc, char ** argv) {
         auto cfg_mode_name = settings.get_default_mode();
         mode = std::find(modes.cbegin(), modes.cend(), cfg_mode_name);
 
-        // initialize cat mode
-        cat = std::make_unique<cats::CustomCat>();
-        if (!cat->init(settings, settings.get_cat_config(cfg_mode_name)))
-            return false;
-
         // update window transform data
         auto cfg_window_size = settings.get_window_size();
         if (window_size != cfg_window_size) {
@@ -80,11 +131,48 @@ int main(int argc, char ** argv) {
                 return false;
         }
 
+        input::set_sampling_rate(settings.get_input_sampling_rate());
+        input::set_monitor(settings.get_input_monitor());
+        input::set_backend(settings.get_input_backend());
+
         // update windows transform
         sf::Transform transform = settings.get_window_transform();
         rstates = sf::RenderStates(transform);
 
-        return true;
+        scene.reset();
+        scene_rstates = rstates;
+        render_params = {window_size, transform, settings.get_window_scale()};
+        const sf::Vector2u render_size = settings.get_render_size();
+        if (render_size != window_size) {
+            scene.emplace();
+            if (scene->resize(render_size)) {
+                scene->setSmooth(true);
+                scene_rstates = sf::RenderStates(settings.get_render_transform());
+                render_params = {render_size, settings.get_render_transform(), settings.get_render_scale()};
+                logger::info("Rendering the cat at " + std::to_string(render_size.x) + "x"
+                    + std::to_string(render_size.y) + " and scaling it to the window");
+            }
+            else {
+                logger::warn("Failed to create a render texture, the cat is rendered at the window's resolution");
+                scene.reset();
+            }
+        }
+
+        // frame times of a replay are measured over rendered frames
+        is_render_on_change = settings.is_render_on_change() && !is_replay;
+        input::set_motion_waking(is_render_on_change);
+
+        const int frame_rate = is_unpaced ? timing::FramePacer::UNLIMITED : settings.get_frame_rate();
+        if (frame_rate != pacer.get_rate())
+            pacer.set_rate(frame_rate);
+        is_mouse_late_latched = settings.is_mouse_late_latched();
+
+        // a recreated window has vsync disabled
+        window.setVerticalSyncEnabled(pacer.is_vsync());
+
+        // initialize cat mode, once it is known what it is drawn into
+        cat = std::make_unique<cats::CustomCat>();
+        return cat->init(settings, settings.get_cat_config(cfg_mode_name), render_params);
     };
 
     while (window.isOpen()) {
@@ -94,6 +182,9 @@ int main(int argc, char ** argv) {
         }
 
         while (const std::optional event = window.pollEvent()) {
+            // the window may need to be redrawn after any of its events
+            is_dirty = true;
+
             if( event->is<sf::Event::Closed>() ) {
                 window.close();
             }
@@ -111,7 +202,7 @@ int main(int argc, char ** argv) {
                         if (mode == modes.end())
                             mode = modes.begin();
                         cat = std::make_unique<cats::CustomCat>();
-                        is_config_loaded = cat->init(settings, settings.get_cat_config(*mode));
+                        is_config_loaded = cat->init(settings, settings.get_cat_config(*mode), render_params);
                     }
                     break;
                 }
@@ -130,26 +221,85 @@ int main(int argc, char ** argv) {
             }
         }
 
+        input::capture_frame(input_frame);
+
+        if (is_replay) {
+            const sf::Time frame_time = frame_clock.restart();
+            if (input::is_replay_finished()) {
+                if (replay_frames > 0) {
+                    logger::info("Replay finished: " + std::to_string(replay_frames) + " frames, average frame time "
+                        + std::to_string(replay_total_time.asMicroseconds() / replay_frames) + " us, maximum "
+                        + std::to_string(replay_max_frame_time.asMicroseconds()) + " us");
+                }
+                window.close();
+                break;
+            }
+            replay_total_time += frame_time;
+            replay_max_frame_time = std::max(replay_max_frame_time, frame_time);
+            ++replay_frames;
+        }
+
         if(!is_config_loaded) {
             window.draw(log_overlay, rstates);
+            pacer.wait();
             window.display();
+            pacer.frame_presented(input_frame.mouse_time);
             continue;
         }
         else {
             log_overlay.set_visible(do_show_debug_overlay);
         }
 
-        window.clear(settings.get_background_color());
-        cat->update();
-        window.draw(*cat, rstates);
+        // the bindings are resolved into keycodes, which change along with the keyboard mapping
+        if (input::take_keymap_change())
+            cat->resolve_keys();
+
+        // the overlays show live data, so they are redrawn every frame
+        is_dirty |= cat->update(input_frame) || do_show_debug_overlay || do_show_input_debug;
+        if (is_render_on_change && !is_dirty) {
+            // nothing has changed, the last frame stays on the screen
+            pacer.pause();
+            input::wait_for_input(std::chrono::duration_cast<std::chrono::microseconds>(pacer.get_period()));
+            continue;
+        }
+        is_dirty = false;
+
+        if (is_mouse_late_latched) {
+            // wait for the deadline before drawing rather than before presenting,
+            // so the paw follows the mouse position sampled right before the present
+            pacer.wait();
+            input::latch_mouse(input_frame);
+            cat->update_mouse(input_frame);
+        }
+
+        if (scene) {
+            if (!cat->is_covering_target())
+                scene->clear(settings.get_background_color());
+            scene->draw(*cat, scene_rstates);
+            scene->display();
+
+            // the scene covers the whole window and is opaque, so it is copied without blending
+            sf::Sprite scene_sprite(scene->getTexture());
+            scene_sprite.setScale(sf::Vector2f(float(window_size.x) / scene->getSize().x,
+                                               float(window_size.y) / scene->getSize().y));
+            window.draw(scene_sprite, sf::RenderStates(sf::BlendNone));
+        }
+        else {
+            if (!cat->is_covering_target())
+                window.clear(settings.get_background_color());
+            window.draw(*cat, rstates);
+        }
 
         window.draw(log_overlay, rstates);
 
         if (do_show_input_debug) {
-            input::drawDebugPanel(window);
+            input::drawDebugPanel(window, input_frame, describe_frame_stats(pacer));
         }
 
+        if (!is_mouse_late_latched)
+            pacer.wait();
         window.display();
+        pacer.frame_presented(input_frame.mouse_time);
     }
 
     input::cleanup();
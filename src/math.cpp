@@ -1,63 +1,33 @@
 
 #include "math.hpp"
 #include <cmath>
-#include <stdexcept>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
 
 namespace math
 {
 
-BCurve::BCurve(uint32_t order)
-    : b_coeff(compute_coefficients(order)) {}
-
-void BCurve::set_control_points(const std::vector<point2d>& p) {
-    if(p.size() != b_coeff.size())
-        throw std::runtime_error("invalid argument");
-
-    points = p;
-}
-
-point2d BCurve::operator()(double t) const {
-    point2d sum = { 0.0, 0.0 };
-    
-    for(uint32_t k = 0; k < points.size(); ++k) {
-        sum.x += basis_polynomial(k, t) * points[k].x;
-        sum.y += basis_polynomial(k, t) * points[k].y;
-    }
-
-    return sum;
-}
-
-std::vector<uint64_t> BCurve::compute_coefficients(uint32_t n) const {
-    std::vector<uint64_t> cf(n+1);
-
-    for( uint32_t k = 0; k <= n; ++k ) {
-        cf[k] = binomial_coefficient(n, k);
+void normalize(float* xs, float* ys, std::size_t count) {
+    std::size_t i = 0;
+
+#if defined(__SSE__)
+    // four vectors at once
+    for (; i + 4 <= count; i += 4) {
+        const __m128 x = _mm_loadu_ps(xs + i);
+        const __m128 y = _mm_loadu_ps(ys + i);
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+        _mm_storeu_ps(xs + i, _mm_div_ps(x, length));
+        _mm_storeu_ps(ys + i, _mm_div_ps(y, length));
     }
+#endif
 
-    return cf;
-}
-
-uint64_t BCurve::binomial_coefficient(uint32_t n, uint32_t k) const {
-    if (k > n)
-        return 0;
-
-    if (k == 0 || k == n)
-        return 1;
-
-    k = std::min(k, n - k); // Take advantage of symmetry
-    uint64_t c = 1;
-
-    for ( uint32_t i = 0; i < k; ++i) {
-        c = c * (n - i) / (i + 1);
+    for (; i < count; ++i) {
+        const float length = std::sqrt(xs[i] * xs[i] + ys[i] * ys[i]);
+        xs[i] /= length;
+        ys[i] /= length;
     }
-
-    return c;
-}
-
-double BCurve::basis_polynomial(uint32_t k, double t) const {
-    // TODO: use the recurrent formula
-    const size_t n = b_coeff.size() - 1;
-    return b_coeff[k] * pow(t, k) * pow(1.0 - t, n - k);
 }
 
 }
@@ -1,11 +1,12 @@
 #include <SFML/System/Vector2.hpp>
 #include <header.hpp>
+#include <x11.hpp>
 extern "C" {
 #include <xdo.h>
 #include <X11/Xlib.h>
-#include <X11/extensions/Xrandr.h>
 }
 
+#include <algorithm>
 #include <cstring>
 #include <string>
 #include <set>
@@ -15,63 +16,88 @@ namespace input
 
 class MouseBase : public IMouse {
 public:
+    MouseBase(IKeyboard& kbd)
+        : keyboard(kbd) {}
+
     bool is_left_button_pressed() override;
     bool is_right_button_pressed() override;
+
+private:
+    // buttons' state is tracked by the keyboard handler
+    IKeyboard& keyboard;
 };
 
 bool MouseBase::is_left_button_pressed() {
-    return sf::Mouse::isButtonPressed(sf::Mouse::Button::Left);
+    return keyboard.is_button_pressed(Button1);
 }
 
 bool MouseBase::is_right_button_pressed() {
-    return sf::Mouse::isButtonPressed(sf::Mouse::Button::Right);
+    return keyboard.is_button_pressed(Button3);
 }
 
-class MouseXdo : public MouseBase
+class MouseXdo : public MouseBase, public IX11EventListener
 {
 public:
 
-    MouseXdo(Display* display, bool left_handed);
+    MouseXdo(Display* display, IKeyboard& keyboard, bool left_handed, const std::string& monitor);
     ~MouseXdo();
 
     // Get the mouse position
     std::pair<double, double> get_position() override;
 
+    void process_x11_event(XEvent& evt) override;
+
 private:
-    void poll_x11_events();
-    void process_x11_event(const XEvent& evt);
     std::string print_window_name(Window w);
+    void update_active_window();
+    void update_window_geometry();
 
     xdo_t* xdo;
     Display* dpy;
+    Atom net_active_window;
+    ScreenLayout screen;
 
     bool is_left_handed;
     bool is_mouse_grab_mode = false;
-    unsigned int screen_w, screen_h;
     std::set<Window> active_windows;
     Window curent_grabbing_window = 0;
+
+    // The active window and its geometry are cached and
+    // requested again only when an event reports a change
+    Window foreground_window = 0;
+    bool is_active_window_changed = true;
+    bool is_geometry_changed = true;
+    int window_x = 0, window_y = 0;
+    unsigned int window_w = 0, window_h = 0;
 };
 
-MouseXdo::MouseXdo(Display* display, bool left_handed)
-    : dpy(display)
+MouseXdo::MouseXdo(Display* display, IKeyboard& keyboard, bool left_handed, const std::string& monitor)
+    : MouseBase(keyboard)
+    , dpy(display)
+    , screen(display, monitor)
     , is_left_handed(left_handed) {
-    xdo = xdo_new(NULL);
-
-    // Get the desktop resolution
-    int num_sizes;
-    Rotation current_rotation;
+    // share the connection, so that all input requests go through one display
+    xdo = xdo_new_with_opened_display(dpy, NULL, 0);
 
-    Window root = RootWindow(dpy, 0);
-    XRRScreenSize *xrrs = XRRSizes(dpy, 0, &num_sizes);
+    Window root = DefaultRootWindow(dpy);
 
-    XRRScreenConfiguration *conf = XRRGetScreenInfo(dpy, root);
-    SizeID current_size_id = XRRConfigCurrentConfiguration(conf, &current_rotation);
+    // the window manager reports the active window change
+    // via a property of the root window
+    net_active_window = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
+    XSelectInput(dpy, root, PropertyChangeMask);
 
-    screen_w = xrrs[current_size_id].width;
-    screen_h = xrrs[current_size_id].height;
+    add_x11_listener(dpy, this);
 }
 
 MouseXdo::~MouseXdo() {
+    remove_x11_listener(dpy, this);
+
+    // the connection may outlive the handler, so deselect the events;
+    // the errors of the windows destroyed meanwhile are ignored
+    XSelectInput(dpy, DefaultRootWindow(dpy), NoEventMask);
+    for (Window w : active_windows)
+        XSelectInput(dpy, w, NoEventMask);
+
     xdo_free(xdo);
 }
 
@@ -88,16 +114,7 @@ std::string MouseXdo::print_window_name(Window w) {
     return window_name;
 }
 
-void MouseXdo::poll_x11_events() {
-    // Process all pending events
-    while(XPending(dpy)) {
-        XEvent evt;
-        XNextEvent(dpy, &evt);
-        process_x11_event(evt);
-    }
-}
-
-void MouseXdo::process_x11_event(const XEvent& evt) {
+void MouseXdo::process_x11_event(XEvent& evt) {
     switch(evt.type) {
         case EnterNotify: {
             // The mouse cursor has entered a window
@@ -142,6 +159,19 @@ void MouseXdo::process_x11_event(const XEvent& evt) {
             }
         }
         break;
+        case PropertyNotify: {
+            if(evt.xproperty.atom == net_active_window) {
+                is_active_window_changed = true;
+            }
+        }
+        break;
+        case ConfigureNotify: {
+            // the active window has been moved or resized
+            if(evt.xconfigure.window == foreground_window) {
+                is_geometry_changed = true;
+            }
+        }
+        break;
         case DestroyNotify: {
             // if the current grabbing window has been closed,
             // disable mouse grabbing mode and delete the window's handle
@@ -155,43 +185,71 @@ void MouseXdo::process_x11_event(const XEvent& evt) {
     }
 }
 
+void MouseXdo::update_active_window() {
+    Window window;
+    // on failure the request is repeated on the next call
+    if (0 != xdo_get_active_window(xdo, &window))
+        return;
+
+    is_active_window_changed = false;
+    if (window != foreground_window) {
+        foreground_window = window;
+        is_geometry_changed = true;
+    }
+
+    // Check if we've already subcribed on the window's events
+    if (active_windows.find(foreground_window) == active_windows.end()) {
+        // Once an active window is found, subscribe to its events we want to receive
+        long evt_types = EnterWindowMask | LeaveWindowMask | FocusChangeMask | StructureNotifyMask;
+        XSelectInput(dpy, foreground_window, evt_types);
+        active_windows.insert(foreground_window);
+    }
+}
+
+void MouseXdo::update_window_geometry() {
+    int pos_x, pos_y;
+    unsigned int width, height;
+
+    if (0 == xdo_get_window_location(xdo, foreground_window, &pos_x, &pos_y, NULL)
+        && 0 == xdo_get_window_size(xdo, foreground_window, &width, &height)) {
+        window_x = pos_x;
+        window_y = pos_y;
+        window_w = width;
+        window_h = height;
+        is_geometry_changed = false;
+    }
+}
+
 std::pair<double, double> MouseXdo::get_position() {
     // The point of this code is that we want to track mouse position differently
     // depending on whether the mouse cursor is grabbed by a window or not.
     // If the active window is grabbing the cursor, then we limit the tracking box
     // size to the active windows's dimensions.
     double sbox_pos_x, sbox_pos_y, sbox_width, sbox_height;
-    Window foreground_window;
-
-    if (0 == xdo_get_active_window(xdo, &foreground_window)) {
-        // Check if we've already subcribed on the window's events
-        if (active_windows.find(foreground_window) == active_windows.end()) {
-            // Once an active window is found, subscribe to its events we want to receive
-            long evt_types = EnterWindowMask | LeaveWindowMask | FocusChangeMask | StructureNotifyMask;
-            XSelectInput(dpy, foreground_window, evt_types);
-            active_windows.insert(foreground_window);
-        }
-        poll_x11_events();
+
+    if (is_active_window_changed) {
+        update_active_window();
     }
 
     // Initialize with the default values; by default
     // assume that no window is grabbing the mouse cursor
-    sbox_width = screen_w;
-    sbox_height = screen_h;
-    sbox_pos_x = sbox_pos_y = 0;
+    const ScreenRect& screen_rect = screen.get_rect();
+    sbox_width = screen_rect.width;
+    sbox_height = screen_rect.height;
+    sbox_pos_x = screen_rect.x;
+    sbox_pos_y = screen_rect.y;
 
     if (is_mouse_grab_mode) {
         // The mouse cursor is being grabbed by the active window
-        int window_pos_x, window_pos_y;
-        if(0 == xdo_get_window_location(xdo, foreground_window, &window_pos_x, &window_pos_y, NULL)) {
-            unsigned int width_ret, height_ret;
-
-            if(0 == xdo_get_window_size(xdo, foreground_window, &width_ret, &height_ret)) {
-                sbox_width = width_ret;
-                sbox_height = height_ret;
-                sbox_pos_x = window_pos_x;
-                sbox_pos_y = window_pos_y;
-            }
+        if (is_geometry_changed) {
+            update_window_geometry();
+        }
+
+        if (!is_geometry_changed) {
+            sbox_width = window_w;
+            sbox_height = window_h;
+            sbox_pos_x = window_x;
+            sbox_pos_y = window_y;
         }
     }
 
@@ -225,27 +283,33 @@ class MouseSfml : public MouseBase
 {
 public:
 
-    MouseSfml(Display* display, bool left_handed);
+    MouseSfml(Display* display, IKeyboard& keyboard, bool left_handed, const std::string& monitor);
     ~MouseSfml() = default;
 
     // get the mouse position
     std::pair<double, double> get_position() override;
 
 private:
+    ScreenLayout screen;
     bool is_left_handed;
 };
 
-MouseSfml::MouseSfml(Display* display, bool left_handed) 
-    : is_left_handed(left_handed) {}
+MouseSfml::MouseSfml(Display* display, IKeyboard& keyboard, bool left_handed, const std::string& monitor)
+    : MouseBase(keyboard)
+    , screen(display, monitor)
+    , is_left_handed(left_handed) {}
 
 std::pair<double, double> MouseSfml::get_position() {
     // get global mouse postion in screen coordinates
     sf::Vector2i mouse_pos = sf::Mouse::getPosition();
-    auto video_mode = sf::VideoMode::getDesktopMode();
+    const ScreenRect& screen_rect = screen.get_rect();
 
     // project into a unit square
-    float x = float(mouse_pos.x) / video_mode.size.x;
-    float y = float(mouse_pos.y) / video_mode.size.y;
+    float x = float(mouse_pos.x - screen_rect.x) / screen_rect.width;
+    float y = float(mouse_pos.y - screen_rect.y) / screen_rect.height;
+
+    x = std::clamp(x, 0.f, 1.f);
+    y = std::clamp(y, 0.f, 1.f);
 
     if (is_left_handed) {
         x = 1.f - x;
@@ -254,7 +318,8 @@ std::pair<double, double> MouseSfml::get_position() {
     return std::make_pair(x, y);
 }
 
-std::unique_ptr<IMouse> create_mouse_handler(void* pdisplay, bool is_left_handed) {
+std::unique_ptr<IMouse> create_mouse_handler(void* pdisplay, IKeyboard& keyboard, bool is_left_handed,
+                                             const std::string& monitor) {
     Display *display = static_cast<Display *>(pdisplay);
     const char* xdg_session_type = getenv("XDG_SESSION_TYPE");
     // unfortunately, xdotool does not work on Wayland sessions. The probmlem is that Wayland does not allow to get the mouse position
@@ -266,11 +331,11 @@ std::unique_ptr<IMouse> create_mouse_handler(void* pdisplay, bool is_left_handed
         // some wayland specific implementations may be added here later, but for now
         // use a simple implementation which utilizes only SFML API to discover mouse position
         logger::info("Mouse tracking is not fully supported in Wayland session");
-        return std::make_unique<MouseSfml>(display, is_left_handed);
+        return std::make_unique<MouseSfml>(display, keyboard, is_left_handed, monitor);
     }
     else {
         // Leave Xorg specific stuff here
-        return std::make_unique<MouseXdo>(display, is_left_handed);
+        return std::make_unique<MouseXdo>(display, keyboard, is_left_handed, monitor);
     }
 }
 
@@ -1,12 +1,18 @@
 #include "header.hpp"
 #include <SFML/Graphics/PrimitiveType.hpp>
-#include <SFML/Graphics/Transform.hpp>
-#include <SFML/System/Angle.hpp>
+#include <SFML/Graphics/Vertex.hpp>
+#include <SFML/Graphics/VertexBuffer.hpp>
 #include <SFML/System/Vector2.hpp>
 #include <cat.hpp>
 #include <input.hpp>
 #include <math.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace cats
 {
@@ -16,6 +22,15 @@ void MousePaw::set_mouse_parameters(sf::Vector2i of, double sc) {
     scale = sc;
 }
 
+void MousePaw::set_render_scale(float sc) {
+    render_scale = sc;
+    paw_mouse_pos.reset();
+}
+
+void MousePaw::set_pose_cache_size(std::size_t size) {
+    pose_cache_size = size;
+}
+
 bool MousePaw::init(const Json::Value& mouse_cfg, const Json::Value& paw_draw_info) {
     data::Validator cfg(mouse_cfg);
     data::Validator paw_cfg(paw_draw_info);
@@ -86,10 +101,55 @@ bool MousePaw::init(const Json::Value& mouse_cfg, const Json::Value& paw_draw_in
     left_button->setScale(scale2f);
     right_button->setScale(scale2f);
 
+    // the shadow of the arm arc is a bit wider than the arc itself
+    auto paw_edge_color_shad = paw_edge_color;
+    paw_edge_color_shad.a /= 3;
+    shadow = {paw_edge_color_shad, 7};
+    edge = {paw_edge_color, 6};
+
+    const double pi = std::acos(-1.0);
+    for (size_t i = 0; i <= cap_segments; ++i) {
+        const float angle = 2 * pi * i / cap_segments;
+        cap_directions[i] = {std::cos(angle), std::sin(angle)};
+    }
+
+    is_paw_buffered = sf::VertexBuffer::isAvailable() && paw_buffer.create(max_paw_vertices);
+    if (!is_paw_buffered)
+        logger::info("Vertex buffers are not available, the paw is drawn from the memory");
+
+    build_pose_cache();
+
+    // the geometry is built anew for the next mouse position
+    paw_mouse_pos.reset();
+
+    return true;
+}
+
+bool MousePaw::update_paw_position(std::pair<double, double> mouse_pos) {
+    // the paw is a function of the mouse position only
+    if (paw_mouse_pos == mouse_pos)
+        return false;
+    paw_mouse_pos = mouse_pos;
+
+    if (pose_cache.grid_size > 0)
+        blend_pose(mouse_pos, geometry);
+    else
+        build_pose(mouse_pos, outline_tolerance, geometry);
+
+    device->setPosition(geometry.device_position);
+    left_button->setPosition(geometry.device_position);
+    right_button->setPosition(geometry.device_position);
+
+    // the buffer is written over in place, it is never reallocated
+    if (is_paw_buffered && !paw_buffer.update(geometry.vertices.data(), geometry.vertex_count, 0)) {
+        logger::warn("Failed to update the paw vertex buffer, drawing the paw from the memory");
+        is_paw_buffered = false;
+    }
+
     return true;
 }
 
-void MousePaw::update_paw_position(std::pair<double, double> mouse_pos) {
+void MousePaw::build_pose(std::pair<double, double> mouse_pos, float tolerance, Geometry& g) const {
     auto [fx, fy] = mouse_pos;
 
     // project the position from the unit square to a parallelogram domain
@@ -99,16 +159,20 @@ void MousePaw::update_paw_position(std::pair<double, double> mouse_pos) {
         (B.y - A.y) * fx + (C.y - A.y) * fy + A.y
     };
 
-    const int oof = 6;
-    math::BCurve B2(2);
-    math::BCurve B3(3);
+    const int oof = arc_segment_samples;
 
     // fixed point where the paw arc starts
     const math::point2d paw_start_d = {(double) paw_start.x, (double) paw_start.y};
     // fixed point where the paw arc ends
     const math::point2d paw_end_d = {(double)paw_end.x, (double)paw_end.y};
 
-    std::vector<math::point2d> pss = {paw_start_d};
+    // the outline's control points are collected in float
+    auto& pss = g.arc_control_points;
+    auto to_float = [](const math::point2d& p) {
+        return sf::Vector2f(p.x, p.y);
+    };
+    size_t n = 0;
+    pss[n++] = to_float(paw_start_d);
 
     double dist = hypot(paw_start_d.x - m.x, paw_start_d.y - m.y);
     // sort of unit tangent vector at the paw_start point of the arc
@@ -117,14 +181,15 @@ void MousePaw::update_paw_position(std::pair<double, double> mouse_pos) {
     const math::point2d centreleft = paw_start_d + tangentleft * (dist / 2);
     
     // the first arc segment
-    std::vector<math::point2d> bez1 = {paw_start_d, centreleft, m};
-    B2.set_control_points(bez1);
+    const SegmentCurve2::control_points bez1 = {paw_start_d, centreleft, m};
+    SegmentCurve2::sample_points samples2;
+    SegmentCurve2::evaluate(bez1, samples2);
 
     for (int i = 1; i < oof; i++) {
-        pss.push_back(B2(1.0 * i / oof));
+        pss[n++] = to_float(samples2[i]);
     }
 
-    pss.push_back(m);
+    pss[n++] = to_float(m);
 
     // rotate centreleft by 90 degrees clockwise
     math::point2d ab;
@@ -154,115 +219,205 @@ void MousePaw::update_paw_position(std::pair<double, double> mouse_pos) {
     st2 *= push / le;
 
     // the second segment
-    std::vector<math::point2d> bez2 = { m, m + st, ab + st2, ab};
-    B3.set_control_points(bez2);
+    const SegmentCurve3::control_points bez2 = { m, m + st, ab + st2, ab};
+    SegmentCurve3::sample_points samples3;
+    SegmentCurve3::evaluate(bez2, samples3);
     for (int i = 1; i < oof; i++) {
-        pss.push_back(B3(1.0 * i / oof));
+        pss[n++] = to_float(samples3[i]);
     }
-    pss.push_back(ab);
+    pss[n++] = to_float(ab);
 
     // the third segment
-    std::vector<math::point2d> bez3 = { paw_end_d, centreright, ab};
-    B2.set_control_points(bez3);
+    const SegmentCurve2::control_points bez3 = { paw_end_d, centreright, ab};
+    SegmentCurve2::evaluate(bez3, samples2);
     for (int i = oof - 1; i > 0; i--) {
-        pss.push_back(B2(1.0 * i / oof));
-    }
-    pss.push_back(paw_end_d);
-
-    const int iter = 25;
-    math::BCurve B18(3 * oof);
-    // constructing a high order curve over a set of control points from existing curves
-    // is pretty much messed up way to do things... TODO: use a spline instead
-    B18.set_control_points(pss);
-
-    std::vector<math::point2d> pss2d = {pss[0]};
-    for (int i = 1; i < iter; i++) {
-        auto p = B18(1.0 * i / iter);
-        pss2d.push_back(p);
+        pss[n++] = to_float(samples2[i]);
     }
-    pss2d.push_back(pss[3 * oof]);
+    pss[n++] = to_float(paw_end_d);
+
+    // the outline passes through the points of the segments; it is
+    // tessellated finer where it bends and where it is drawn larger
+    const math::CatmullRomSpline<float> outline(pss.data(), pss.size());
+    g.paw_point_count = outline.tessellate(tolerance, render_scale, max_span_pieces,
+                                           g.pss2.data(), g.pss2_params.data());
 
     // mouse position is the corner of the mouse sprite
     // need some offset depending on the actual sprite being used
     const math::point2d moffset = {-52 - 15, -34 + 5};
     const math::point2d dpos = (ab + m) / 2.0 + moffset;
-    const sf::Vector2f dpos2f{(float)dpos.x + offset.x, (float)dpos.y + offset.y};
+    g.device_position = {(float)dpos.x + offset.x, (float)dpos.y + offset.y};
+
+    build_geometry(g);
+}
+
+void MousePaw::draw_paw(sf::RenderTarget& target, sf::RenderStates rst) const {
+    // the triangles are drawn in the order they have been added,
+    // so the arcs are blended over the arm's body in a single call
+    if (is_paw_buffered)
+        target.draw(paw_buffer, 0, geometry.vertex_count, rst);
+    else
+        target.draw(geometry.vertices.data(), geometry.vertex_count, sf::PrimitiveType::Triangles, rst);
+}
 
-    device->setPosition(dpos2f);
-    left_button->setPosition(dpos2f);
-    right_button->setPosition(dpos2f);
+void MousePaw::build_geometry(Geometry& g) const {
+    const size_t nump = g.paw_point_count;
+    g.vertex_count = 0;
 
-    // convert to float (consider to perform math in float in the first place)
-    std::vector<sf::Vector2f> pss2f;
-    for(auto pd : pss2d) {
-        pss2f.push_back(sf::Vector2f(pd.x, pd.y));
+    // construct vectors pointing at the direction of the next paw point, the last
+    // point uses the previous one; all the arcs are built around the same normals
+    for (size_t i = 0; i + 1 < nump; ++i) {
+        g.direction_x[i] = g.pss2[i].x - g.pss2[i + 1].x;
+        g.direction_y[i] = g.pss2[i].y - g.pss2[i + 1].y;
     }
+    g.direction_x[nump - 1] = g.direction_x[nump - 2];
+    g.direction_y[nump - 1] = g.direction_y[nump - 2];
+    math::normalize(g.direction_x.data(), g.direction_y.data(), nump);
 
-    pss2 = std::move(pss2f);
+    // arm's body, a strip zigzagging between both ends of the outline
+    auto fill_point = [&](size_t i) {
+        return i % 2 == 0 ? g.pss2[i / 2] : g.pss2[nump - 1 - i / 2];
+    };
+    for (size_t i = 0; i + 2 < nump; ++i) {
+        g.vertices[g.vertex_count++] = sf::Vertex{fill_point(i), paw_color};
+        g.vertices[g.vertex_count++] = sf::Vertex{fill_point(i + 1), paw_color};
+        g.vertices[g.vertex_count++] = sf::Vertex{fill_point(i + 2), paw_color};
+    }
+
+    // the shadow of the arm arc, then the line of the arm arc
+    add_arc(g, shadow);
+    add_arc(g, edge);
 }
 
-void MousePaw::draw_paw(sf::RenderTarget& target, sf::RenderStates rst) const {
-    // drawing arm's body
-    const size_t nump = pss2.size();
-    sf::VertexArray fill(sf::PrimitiveType::TriangleStrip, nump);
-    for (size_t i = 0; i < nump; i += 2) {
-        fill[i].position = pss2[i];
-        fill[i + 1].position = pss2[nump - i - 1];
-        fill[i].color = fill[i + 1].color = paw_color;
+void MousePaw::add_arc(Geometry& g, const Arc& arc) const {
+    const size_t nump = g.paw_point_count;
+
+    // the beginning of the arc is rounded
+    add_cap(g, g.pss2[0], arc.width / 2, arc.color);
+
+    // to form the arc we use points from the left and from the right
+    // of the outline points, at half of the arc width from them
+    auto side_point = [&](size_t i, float side) {
+        // the arc narrows along the outline
+        const float offset = side * (arc.width - arc_taper * g.pss2_params[i]) / 2;
+        // the vector is rotated by 90 degrees counter-clockwise for the left side
+        return g.pss2[i] + sf::Vector2f(g.direction_y[i], -g.direction_x[i]) * offset;
+    };
+
+    sf::Vector2f left = side_point(0, 1), right = side_point(0, -1);
+    for (size_t i = 1; i < nump; ++i) {
+        const sf::Vector2f next_left = side_point(i, 1), next_right = side_point(i, -1);
+        g.vertices[g.vertex_count++] = sf::Vertex{left, arc.color};
+        g.vertices[g.vertex_count++] = sf::Vertex{right, arc.color};
+        g.vertices[g.vertex_count++] = sf::Vertex{next_left, arc.color};
+        g.vertices[g.vertex_count++] = sf::Vertex{right, arc.color};
+        g.vertices[g.vertex_count++] = sf::Vertex{next_left, arc.color};
+        g.vertices[g.vertex_count++] = sf::Vertex{next_right, arc.color};
+        left = next_left;
+        right = next_right;
     }
-    target.draw(fill, rst);
 
-    // drawing the shadow of the arm arc
-    auto paw_edge_color_shad = paw_edge_color;
-    paw_edge_color_shad.a /= 3;
-    draw_arc(target, rst, paw_edge_color_shad, 7);
+    // at the end of the arc there is also a round cap
+    add_cap(g, g.pss2[nump - 1], (arc.width - arc_taper) / 2, arc.color);
+}
 
-    // drawing the line of the arm arc
-    draw_arc(target, rst, paw_edge_color, 6);
+void MousePaw::add_cap(Geometry& g, sf::Vector2f center, float radius, sf::Color color) const {
+    for (size_t i = 0; i < cap_segments; ++i) {
+        g.vertices[g.vertex_count++] = sf::Vertex{center, color};
+        g.vertices[g.vertex_count++] = sf::Vertex{center + cap_directions[i] * radius, color};
+        g.vertices[g.vertex_count++] = sf::Vertex{center + cap_directions[i + 1] * radius, color};
+    }
 }
 
-void MousePaw::draw_arc(sf::RenderTarget& target, sf::RenderStates rst, sf::Color color, float width) const {
-    // at the first point of the arc we draw a circle shape
-    // in order to make arc's beginning rounded
-    sf::CircleShape circ(width / 2);
-    circ.setFillColor(color);
-    // the coordinates of the sprite are the coordinates of the upper left corner
-    // of the "enclosing box", so it's needed to set the coordinates accordingly
-    sf::Vector2f offset(width / 2, width / 2);
-    circ.setPosition(pss2[0] - offset);
-    target.draw(circ, rst);
-
-    sf::Transform rotate_left, rotate_right;
-    rotate_left.rotate(sf::degrees(-90)); // counter-clockwise rotation
-    rotate_right.rotate(sf::degrees(90)); // clockwise rotation
-
-    // Next, we draw the arm's arc, using triangle strip
-    const size_t nump = pss2.size();
-    sf::VertexArray edge(sf::PrimitiveType::TriangleStrip, nump * 2);
-    for (size_t i = 0; i < nump; i += 1, width -= 0.08) {
-        // construct a vector, pointing at the direction of the next paw point
-        auto vec = (i == nump-1) 
-            ? pss2[i-1] - pss2[i]  // the last point edge case; use the 
-            : pss2[i] - pss2[i+1]; // previous point to construct the vector
-        // set the length of the vector to width/2
-        float dist = hypot(vec.x, vec.y);
-        vec = vec / dist * (width / 2);
-
-        // to form the triangle strip we use points from the left 
-        // and from the right of the current point
-        edge[2*i].position   = pss2[i] + rotate_left * vec;
-        edge[2*i+1].position = pss2[i] + rotate_right * vec;
-
-        // set the trianle's edge color
-        edge[2*i].color = edge[2*i+1].color = color;
+void MousePaw::build_pose_cache() {
+    pose_cache = PoseCache();
+    if (pose_cache_size == 0)
+        return;
+
+    // every pose is tessellated the same way, so the poses differ only
+    // in the positions of their vertices, the colors are taken from this one
+    build_pose({0.0, 0.0}, 0, geometry);
+    const size_t vertex_count = geometry.vertex_count;
+
+    const size_t pose_size = (vertex_count + 1) * sizeof(sf::Vector2f);
+    const size_t n = std::min<size_t>(std::sqrt(double(pose_cache_size / pose_size)), max_pose_grid_size);
+    if (n < 2) {
+        logger::warn("The paw pose cache is too small to hold a grid of poses, "
+                     "the poses are computed every frame");
+        return;
     }
 
-    // at the end of the arc also draw a circle shape
-    target.draw(edge, rst);
-    circ.setRadius(width / 2);
-    offset = sf::Vector2f(width / 2, width / 2);
-    circ.setPosition(pss2[nump-1] - offset);
-    target.draw(circ, rst);
+    const size_t pose_count = n * n;
+    pose_cache.positions.resize(pose_count * vertex_count);
+    pose_cache.device_positions.resize(pose_count);
+
+    const auto start_time = std::chrono::steady_clock::now();
+
+    // the poses are independent of each other, they are handed out to the threads one by one
+    std::atomic<size_t> next_pose{0};
+    auto compute_poses = [&]() {
+        auto g = std::make_unique<Geometry>();
+        for (size_t pose = next_pose++; pose < pose_count; pose = next_pose++) {
+            const std::pair<double, double> mouse_pos = {
+                double(pose % n) / (n - 1), double(pose / n) / (n - 1)
+            };
+            build_pose(mouse_pos, 0, *g);
+
+            auto positions = pose_cache.positions.begin() + pose * vertex_count;
+            for (size_t i = 0; i < vertex_count; ++i)
+                positions[i] = g->vertices[i].position;
+            pose_cache.device_positions[pose] = g->device_position;
+        }
+    };
+
+    const size_t thread_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, pose_count);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; ++i)
+        threads.emplace_back(compute_poses);
+    compute_poses();
+    for (auto& thread : threads)
+        thread.join();
+
+    pose_cache.grid_size = n;
+    pose_cache.vertex_count = vertex_count;
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time);
+    const size_t memory = (pose_cache.positions.size() + pose_cache.device_positions.size())
+        * sizeof(sf::Vector2f);
+    logger::info("Paw pose cache: " + std::to_string(n) + "x" + std::to_string(n) + " poses, "
+        + std::to_string(memory / 1024) + " KiB, computed in " + std::to_string(elapsed.count())
+        + " ms on " + std::to_string(thread_count) + " threads");
+}
+
+void MousePaw::blend_pose(std::pair<double, double> mouse_pos, Geometry& g) const {
+    const size_t n = pose_cache.grid_size;
+    const size_t vertex_count = pose_cache.vertex_count;
+
+    // find the grid cell the position is in and the position within the cell
+    const double gx = std::clamp(mouse_pos.first, 0.0, 1.0) * (n - 1);
+    const double gy = std::clamp(mouse_pos.second, 0.0, 1.0) * (n - 1);
+    const size_t x = std::min<size_t>(gx, n - 2);
+    const size_t y = std::min<size_t>(gy, n - 2);
+    const float tx = gx - x, ty = gy - y;
+
+    // bilinear weights of the poses at the corners of the cell
+    const float w00 = (1 - tx) * (1 - ty), w10 = tx * (1 - ty);
+    const float w01 = (1 - tx) * ty, w11 = tx * ty;
+
+    const size_t pose00 = y * n + x, pose10 = pose00 + 1;
+    const size_t pose01 = pose00 + n, pose11 = pose01 + 1;
+    const sf::Vector2f* p00 = &pose_cache.positions[pose00 * vertex_count];
+    const sf::Vector2f* p10 = &pose_cache.positions[pose10 * vertex_count];
+    const sf::Vector2f* p01 = &pose_cache.positions[pose01 * vertex_count];
+    const sf::Vector2f* p11 = &pose_cache.positions[pose11 * vertex_count];
+
+    // the colors are the same for all the poses and are left as they are
+    for (size_t i = 0; i < vertex_count; ++i)
+        g.vertices[i].position = p00[i] * w00 + p10[i] * w10 + p01[i] * w01 + p11[i] * w11;
+    g.vertex_count = vertex_count;
+
+    const auto& dp = pose_cache.device_positions;
+    g.device_position = dp[pose00] * w00 + dp[pose10] * w10 + dp[pose01] * w01 + dp[pose11] * w11;
 }
 
 }
@@ -0,0 +1,130 @@
+#include <pacer.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace timing
+{
+
+namespace
+{
+
+// bounds of the time spun before a deadline
+const auto MIN_SPIN_TIME = std::chrono::microseconds(50);
+const auto MAX_SPIN_TIME = std::chrono::microseconds(2000);
+
+}
+
+FramePacer::FramePacer()
+    : spin_time(std::chrono::microseconds(500)) {
+    set_rate(DEFAULT_FRAME_RATE);
+}
+
+void FramePacer::set_rate(int r) {
+    rate = r > 0 ? std::clamp(r, MIN_FRAME_RATE, MAX_FRAME_RATE) : r;
+    period = std::chrono::duration_cast<clock::duration>(std::chrono::seconds(1))
+        / (rate > 0 ? rate : DEFAULT_FRAME_RATE);
+
+    deadline = clock::now();
+    has_last_present = false;
+    interval_count = 0;
+    next_interval = 0;
+    latency_count = 0;
+    next_latency = 0;
+}
+
+void FramePacer::wait() {
+    if (rate <= 0)
+        return;
+
+    deadline += period;
+    const auto now = clock::now();
+    if (deadline <= now) {
+        // the frame is late, do not try to catch up
+        deadline = now;
+        return;
+    }
+
+    const auto wakeup = deadline - spin_time;
+    if (wakeup > now) {
+        std::this_thread::sleep_until(wakeup);
+
+        // keep the spin time about twice the usual wakeup latency
+        const auto latency = clock::now() - wakeup;
+        spin_time += (2 * latency - spin_time) / 8;
+        spin_time = std::clamp<clock::duration>(spin_time, MIN_SPIN_TIME, MAX_SPIN_TIME);
+    }
+
+    while (clock::now() < deadline)
+        std::this_thread::yield();
+}
+
+void FramePacer::frame_presented(clock::time_point input_time) {
+    const auto now = clock::now();
+
+    latencies[next_latency] = now - input_time;
+    next_latency = (next_latency + 1) % history_size;
+    latency_count = std::min(latency_count + 1, history_size);
+
+    if (has_last_present) {
+        intervals[next_interval] = now - last_present;
+        next_interval = (next_interval + 1) % history_size;
+        interval_count = std::min(interval_count + 1, history_size);
+    }
+
+    last_present = now;
+    has_last_present = true;
+}
+
+void FramePacer::pause() {
+    has_last_present = false;
+}
+
+FrameStats FramePacer::get_stats() const {
+    FrameStats stats;
+    using namespace std::chrono;
+
+    if (latency_count > 0) {
+        clock::duration total{0}, max_latency{0};
+        for (size_t i = 0; i < latency_count; ++i) {
+            total += latencies[i];
+            max_latency = std::max(max_latency, latencies[i]);
+        }
+        stats.mean_latency = duration_cast<microseconds>(total / latency_count);
+        stats.max_latency = duration_cast<microseconds>(max_latency);
+    }
+
+    if (interval_count == 0)
+        return stats;
+
+    clock::duration total{0};
+    for (size_t i = 0; i < interval_count; ++i)
+        total += intervals[i];
+    const clock::duration mean = total / interval_count;
+
+    // the driver's refresh period is not known, so with vsync
+    // the deviations are measured from the average interval
+    const clock::duration target = rate > 0 ? period : mean;
+
+    double square_sum = 0;
+    clock::duration max_deviation{0};
+    for (size_t i = 0; i < interval_count; ++i) {
+        const clock::duration deviation = intervals[i] > target
+            ? intervals[i] - target : target - intervals[i];
+        const double us = duration<double, std::micro>(deviation).count();
+        square_sum += us * us;
+        max_deviation = std::max(max_deviation, deviation);
+
+        if (2 * intervals[i] > 3 * target)
+            ++stats.late_frames;
+    }
+
+    stats.mean_interval = duration_cast<microseconds>(mean);
+    stats.jitter = microseconds(std::lround(std::sqrt(square_sum / interval_count)));
+    stats.max_jitter = duration_cast<microseconds>(max_deviation);
+    stats.frames = interval_count;
+    return stats;
+}
+
+}
@@ -0,0 +1,236 @@
+#include <header.hpp>
+#include <replay.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+namespace input
+{
+
+namespace
+{
+
+const char REPLAY_MAGIC[4] = {'B', 'C', 'I', 'R'};
+const uint32_t REPLAY_VERSION = 1;
+
+// flags of the record's parts following the header
+enum RecordFlags : uint8_t
+{
+    KeysChanged =       1 << 0,
+    // latched keys are written only if they differ from the held ones
+    LatchedKeys =       1 << 1,
+    JoystickChanged =   1 << 2,
+    MouseMoved =        1 << 3,
+    ButtonsChanged =    1 << 4,
+    HasKeyPresses =     1 << 5
+};
+
+// The values are stored in the host byte order; recordings
+// are not meant to be moved between different architectures
+template<typename T>
+void write_value(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename T>
+bool read_value(std::ifstream& file, T& value) {
+    return bool(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+void write_mask(std::ofstream& file, const KeyMask& mask) {
+    uint8_t bytes[KeyMask().size() / 8] = {};
+    for (size_t i = 0; i < mask.size(); ++i) {
+        if (mask.test(i))
+            bytes[i / 8] |= 1 << (i % 8);
+    }
+    write_value(file, bytes);
+}
+
+bool read_mask(std::ifstream& file, KeyMask& mask) {
+    uint8_t bytes[KeyMask().size() / 8];
+    if (!read_value(file, bytes))
+        return false;
+
+    for (size_t i = 0; i < mask.size(); ++i)
+        mask[i] = (bytes[i / 8] & (1 << (i % 8))) != 0;
+    return true;
+}
+
+}
+
+bool InputRecorder::open(const std::string& path) {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        logger::error("Failed to create input recording " + path);
+        return false;
+    }
+
+    file.write(REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    write_value(file, REPLAY_VERSION);
+    is_first_frame = true;
+    return true;
+}
+
+void InputRecorder::write(const InputFrame& frame) {
+    if (is_first_frame)
+        start_time = frame.sample_time;
+
+    uint8_t flags = 0;
+    if (is_first_frame || frame.keys != last_frame.keys)
+        flags |= KeysChanged;
+    if (frame.latched_keys != frame.keys)
+        flags |= LatchedKeys;
+    if (is_first_frame || frame.joystick != last_frame.joystick)
+        flags |= JoystickChanged;
+    if (is_first_frame || frame.mouse_pos != last_frame.mouse_pos)
+        flags |= MouseMoved;
+    if (is_first_frame
+        || frame.is_left_button_pressed != last_frame.is_left_button_pressed
+        || frame.is_right_button_pressed != last_frame.is_right_button_pressed)
+        flags |= ButtonsChanged;
+    if (!frame.key_presses.empty())
+        flags |= HasKeyPresses;
+
+    using namespace std::chrono;
+    const int64_t time = duration_cast<microseconds>(frame.sample_time - start_time).count();
+    write_value(file, time);
+    write_value(file, flags);
+
+    if (flags & KeysChanged)
+        write_mask(file, frame.keys);
+    if (flags & LatchedKeys)
+        write_mask(file, frame.latched_keys);
+    if (flags & JoystickChanged)
+        write_value(file, uint64_t(frame.joystick.to_ullong()));
+    if (flags & MouseMoved) {
+        write_value(file, frame.mouse_pos.first);
+        write_value(file, frame.mouse_pos.second);
+    }
+    if (flags & ButtonsChanged) {
+        const uint8_t buttons = (frame.is_left_button_pressed ? 1 : 0)
+                              | (frame.is_right_button_pressed ? 2 : 0);
+        write_value(file, buttons);
+    }
+    if (flags & HasKeyPresses) {
+        write_value(file, uint32_t(frame.key_presses.size()));
+        for (const auto& press : frame.key_presses) {
+            write_value(file, uint8_t(press.keycode));
+            write_value(file, uint64_t(press.time));
+        }
+    }
+
+    // the presses are not needed for the comparison with the next frame
+    last_frame.keys = frame.keys;
+    last_frame.joystick = frame.joystick;
+    last_frame.mouse_pos = frame.mouse_pos;
+    last_frame.is_left_button_pressed = frame.is_left_button_pressed;
+    last_frame.is_right_button_pressed = frame.is_right_button_pressed;
+    is_first_frame = false;
+}
+
+bool InputPlayer::open(const std::string& path, bool paced) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        logger::error("Failed to open input recording " + path);
+        return false;
+    }
+
+    char magic[sizeof(REPLAY_MAGIC)];
+    uint32_t version = 0;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0
+        || !read_value(file, version) || version != REPLAY_VERSION) {
+        logger::error("File " + path + " is not a supported input recording");
+        return false;
+    }
+
+    is_paced = paced;
+    start_time = std::chrono::steady_clock::now();
+    has_record = read_record();
+    return true;
+}
+
+bool InputPlayer::read_record() {
+    int64_t time;
+    uint8_t flags;
+    if (!read_value(file, time) || !read_value(file, flags))
+        return false;
+
+    record_time = std::chrono::microseconds(time);
+
+    if ((flags & KeysChanged) && !read_mask(file, record.keys))
+        return false;
+
+    record.latched_keys = record.keys;
+    if ((flags & LatchedKeys) && !read_mask(file, record.latched_keys))
+        return false;
+
+    if (flags & JoystickChanged) {
+        uint64_t joystick;
+        if (!read_value(file, joystick))
+            return false;
+        record.joystick = JoystickMask(joystick);
+    }
+
+    if (flags & MouseMoved) {
+        if (!read_value(file, record.mouse_pos.first) || !read_value(file, record.mouse_pos.second))
+            return false;
+    }
+
+    if (flags & ButtonsChanged) {
+        uint8_t buttons;
+        if (!read_value(file, buttons))
+            return false;
+        record.is_left_button_pressed = buttons & 1;
+        record.is_right_button_pressed = buttons & 2;
+    }
+
+    record.key_presses.clear();
+    if (flags & HasKeyPresses) {
+        uint32_t count;
+        if (!read_value(file, count))
+            return false;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint8_t keycode;
+            uint64_t press_time;
+            if (!read_value(file, keycode) || !read_value(file, press_time))
+                return false;
+            record.key_presses.push_back({keycode, static_cast<unsigned long>(press_time)});
+        }
+    }
+
+    return true;
+}
+
+bool InputPlayer::read(InputFrame& frame) {
+    if (!has_record)
+        return false;
+
+    frame.key_presses.clear();
+    frame.latched_keys = frame.keys;
+
+    const auto now = std::chrono::steady_clock::now();
+    bool is_due = !is_paced || start_time + record_time <= now;
+
+    // a paced player merges all the records which are due, so the presses
+    // are kept even if the frame rate is lower than the recorded one
+    while (has_record && is_due) {
+        frame.keys = record.keys;
+        frame.latched_keys |= record.latched_keys;
+        frame.joystick = record.joystick;
+        frame.mouse_pos = record.mouse_pos;
+        frame.is_left_button_pressed = record.is_left_button_pressed;
+        frame.is_right_button_pressed = record.is_right_button_pressed;
+        frame.key_presses.insert(frame.key_presses.end(),
+                                 record.key_presses.begin(), record.key_presses.end());
+        frame.sample_time = start_time + record_time;
+        frame.mouse_time = frame.sample_time;
+
+        has_record = read_record();
+        is_due = is_paced && start_time + record_time <= now;
+    }
+
+    frame.x_requests = 0;
+    return true;
+}
+
+}
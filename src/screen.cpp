@@ -0,0 +1,137 @@
+#include <header.hpp>
+#include <x11.hpp>
+extern "C" {
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+}
+
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+namespace input
+{
+
+ScreenLayout::ScreenLayout(Display* display, const std::string& monitor)
+    : dpy(display)
+    , monitor_name(monitor) {
+    int rr_error_base;
+    if (XRRQueryExtension(dpy, &rr_event_base, &rr_error_base)) {
+        // get notified about resolution changes and monitors being (un)plugged
+        XRRSelectInput(dpy, DefaultRootWindow(dpy),
+            RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+    }
+    else {
+        rr_event_base = -1;
+        logger::info("XRandR extension is not available, the mouse is mapped onto the whole screen");
+    }
+
+    add_x11_listener(dpy, this);
+}
+
+ScreenLayout::~ScreenLayout() {
+    remove_x11_listener(dpy, this);
+
+    // the connection may outlive the layout, so stop the notifications
+    if (rr_event_base >= 0)
+        XRRSelectInput(dpy, DefaultRootWindow(dpy), 0);
+}
+
+const ScreenRect& ScreenLayout::get_rect() {
+    if (is_changed) {
+        query_monitors();
+        is_changed = false;
+    }
+    return rect;
+}
+
+void ScreenLayout::process_x11_event(XEvent& evt) {
+    if (rr_event_base < 0)
+        return;
+
+    if (evt.type == rr_event_base + RRScreenChangeNotify) {
+        // keep the screen size reported by Xlib up to date
+        XRRUpdateConfiguration(&evt);
+        is_changed = true;
+    }
+    else if (evt.type == rr_event_base + RRNotify) {
+        is_changed = true;
+    }
+}
+
+void ScreenLayout::query_monitors() {
+    // the whole desktop is the default
+    const int screen = DefaultScreen(dpy);
+    rect.x = rect.y = 0;
+    rect.width = std::max(DisplayWidth(dpy, screen), 1);
+    rect.height = std::max(DisplayHeight(dpy, screen), 1);
+
+    if (monitor_name.empty() || rr_event_base < 0)
+        return;
+
+    const Window root = DefaultRootWindow(dpy);
+    XRRScreenResources* resources = XRRGetScreenResourcesCurrent(dpy, root);
+    if (!resources)
+        return;
+
+    struct Monitor
+    {
+        std::string name;
+        bool is_primary;
+        ScreenRect rect;
+    };
+
+    // collect the outputs which are enabled
+    std::vector<Monitor> monitors;
+    const RROutput primary = XRRGetOutputPrimary(dpy, root);
+    for (int i = 0; i < resources->noutput; i++) {
+        XRROutputInfo* output = XRRGetOutputInfo(dpy, resources, resources->outputs[i]);
+        if (!output)
+            continue;
+
+        if (output->connection == RR_Connected && output->crtc) {
+            XRRCrtcInfo* crtc = XRRGetCrtcInfo(dpy, resources, output->crtc);
+            if (crtc) {
+                if (crtc->width > 0 && crtc->height > 0) {
+                    ScreenRect crtc_rect;
+                    crtc_rect.x = crtc->x;
+                    crtc_rect.y = crtc->y;
+                    crtc_rect.width = crtc->width;
+                    crtc_rect.height = crtc->height;
+                    monitors.push_back({std::string(output->name, output->nameLen),
+                                        resources->outputs[i] == primary, crtc_rect});
+                }
+                XRRFreeCrtcInfo(crtc);
+            }
+        }
+        XRRFreeOutputInfo(output);
+    }
+    XRRFreeScreenResources(resources);
+
+    // monitors are counted from left to right
+    std::stable_sort(monitors.begin(), monitors.end(), [](const Monitor& a, const Monitor& b) {
+        return a.rect.x < b.rect.x || (a.rect.x == b.rect.x && a.rect.y < b.rect.y);
+    });
+
+    auto it = std::find_if(monitors.begin(), monitors.end(), [this](const Monitor& m) {
+        return m.name == monitor_name || (monitor_name == "primary" && m.is_primary);
+    });
+
+    const bool is_index = std::all_of(monitor_name.begin(), monitor_name.end(),
+        [](unsigned char c) { return std::isdigit(c); });
+    if (it == monitors.end() && is_index && monitor_name.size() < 4) {
+        const size_t index = std::stoul(monitor_name);
+        if (index < monitors.size())
+            it = monitors.begin() + index;
+    }
+
+    if (it == monitors.end()) {
+        logger::warn("Monitor " + monitor_name + " is not found, the mouse is mapped onto the whole screen");
+        return;
+    }
+
+    rect = it->rect;
+    logger::info("Mapping the mouse onto monitor " + it->name);
+}
+
+}
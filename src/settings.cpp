@@ -9,23 +9,38 @@
 namespace
 {
 
-std::optional<std::string> parse_cmd_options(int argc, char** argv) {
+struct CmdOptions
+{
+    std::optional<std::string> config;
+    std::optional<std::string> record;
+    std::optional<std::string> replay;
+    bool is_replay_unpaced = false;
+};
+
+CmdOptions parse_cmd_options(int argc, char** argv) {
     cxxopts::Options opts("BongoCat", "Configurable Bongo cat overlay");
 
     opts.add_options()
-        ("config", "Config file path", cxxopts::value<std::string>());
+        ("config", "Config file path", cxxopts::value<std::string>())
+        ("record", "Record the input into a file", cxxopts::value<std::string>())
+        ("replay", "Replay the input recorded into a file", cxxopts::value<std::string>())
+        ("replay-unpaced", "Replay a recorded frame every frame as fast as possible");
 
     opts.parse_positional("config");
 
-    try {
-        auto parsed_opts = opts.parse(argc, argv);
-        return parsed_opts["config"].as<std::string>();
-    }
-    catch(cxxopts::exceptions::option_has_no_value&) {
-        // valid case: no config file specified
-    }
+    auto parsed_opts = opts.parse(argc, argv);
+    CmdOptions result;
+
+    // all the options are optional
+    if (parsed_opts.count("config"))
+        result.config = parsed_opts["config"].as<std::string>();
+    if (parsed_opts.count("record"))
+        result.record = parsed_opts["record"].as<std::string>();
+    if (parsed_opts.count("replay"))
+        result.replay = parsed_opts["replay"].as<std::string>();
+    result.is_replay_unpaced = parsed_opts.count("replay-unpaced") > 0;
 
-    return std::nullopt;
+    return result;
 }
 
 }
@@ -36,7 +51,11 @@ bool ConfigFile::init(int argc, char** argv) {
     std::optional<std::string> conf_file_opt;
 
     try { // try to get a config file from command line
-        conf_file_opt = parse_cmd_options(argc, argv);
+        CmdOptions cmd_options = parse_cmd_options(argc, argv);
+        conf_file_opt = cmd_options.config;
+        record_path = cmd_options.record;
+        replay_path = cmd_options.replay;
+        replay_unpaced = cmd_options.is_replay_unpaced;
     }
     catch(cxxopts::exceptions::exception &e) {
         logger::info(std::string("Failed to parse arguments:") + e.what());
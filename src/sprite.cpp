@@ -0,0 +1,144 @@
+#include <sprite.hpp>
+#include <header.hpp>
+
+#include <algorithm>
+
+namespace cats
+{
+
+void AtlasSprite::add_to(SpriteQueue& queue) const {
+    queue.add(region, getTransform());
+}
+
+namespace
+{
+
+bool contains(const sf::FloatRect& outer, const sf::FloatRect& inner) {
+    return outer.position.x <= inner.position.x && outer.position.y <= inner.position.y
+        && outer.position.x + outer.size.x >= inner.position.x + inner.size.x
+        && outer.position.y + outer.size.y >= inner.position.y + inner.size.y;
+}
+
+}
+
+void SpriteQueue::clear() {
+    items.clear();
+    group = 0;
+}
+
+void SpriteQueue::add(const data::TextureRegion& region, const sf::Transform& transform) {
+    // a fully transparent image is trimmed away entirely
+    if (region.rect.size.x <= 0 || region.rect.size.y <= 0)
+        return;
+
+    const sf::FloatRect bounds = transform.transformRect({region.offset, region.get_size()});
+
+    // a rotated sprite does not cover the whole of its bounding rectangle
+    const float* matrix = transform.getMatrix();
+    const bool is_axis_aligned = matrix[1] == 0 && matrix[4] == 0;
+
+    items.push_back({region, transform, bounds, region.is_opaque && is_axis_aligned, group});
+}
+
+void SpriteQueue::next_group() {
+    ++group;
+}
+
+void SpriteQueue::arrange() {
+    // the buffers are swapped, so both keep their capacity
+    // and a queue rebuilt every frame allocates nothing
+    arranged.clear();
+
+    for (size_t i = 0; i < items.size(); ++i) {
+        const Item& item = items[i];
+
+        // the sprites drawn later in any group are drawn over this one
+        const bool is_covered = std::any_of(items.begin() + i + 1, items.end(), [&item](const Item& other) {
+            return other.is_occluder && contains(other.bounds, item.bounds);
+        });
+        if (is_covered)
+            continue;
+
+        // the sprite is moved down to the latest sprite with the same texture,
+        // past the sprites it does not overlap
+        size_t position = arranged.size();
+        for (size_t k = arranged.size(); k-- > 0;) {
+            const Item& other = arranged[k];
+            if (other.group != item.group)
+                break;
+            if (other.region.texture == item.region.texture) {
+                position = k + 1;
+                break;
+            }
+            if (other.bounds.findIntersection(item.bounds))
+                break;
+        }
+        arranged.insert(arranged.begin() + position, item);
+    }
+
+    items.swap(arranged);
+}
+
+void SpriteQueue::add_group_to(std::size_t g, SpriteBatch& batch) const {
+    for (const auto& item : items) {
+        if (item.group == g)
+            batch.add(item.region, item.transform);
+    }
+}
+
+void SpriteBatch::clear() {
+    vertices.clear();
+    runs.clear();
+}
+
+void SpriteBatch::add(const data::TextureRegion& region, const sf::Transform& transform) {
+    // a fully transparent image is trimmed away entirely
+    if (region.rect.size.x <= 0 || region.rect.size.y <= 0)
+        return;
+
+    const sf::Vector2f position(region.rect.position);
+    const sf::Vector2f size(region.rect.size);
+
+    // the corners in the texture, in the same layout as the one of sf::Sprite;
+    // on the screen the region is drawn where it is in the original image,
+    // at its original size, so a resampled image is not scaled again
+    const sf::Vector2f corners[4] = {{0, 0}, {0, size.y}, {size.x, 0}, {size.x, size.y}};
+    sf::Vertex quad[4];
+    for (int i = 0; i < 4; ++i) {
+        quad[i] = sf::Vertex{transform.transformPoint(region.offset + corners[i].componentWiseDiv(region.scale)),
+                             sf::Color::White, position + corners[i]};
+    }
+
+    if (runs.empty() || runs.back().texture != region.texture)
+        runs.push_back({region.texture, vertices.size(), 0});
+
+    for (int i : {0, 1, 2, 2, 1, 3})
+        vertices.push_back(quad[i]);
+    runs.back().count += 6;
+}
+
+void SpriteBatch::upload() {
+    if (!is_buffered || vertices.empty())
+        return;
+
+    // the buffer only grows, so a batch of a similar size is written over in place
+    if (buffer.getVertexCount() < vertices.size())
+        is_buffered = buffer.create(std::max(vertices.size(), 2 * buffer.getVertexCount()));
+
+    if (!is_buffered || !buffer.update(vertices.data(), vertices.size(), 0)) {
+        logger::warn("Failed to update the sprite vertex buffer, drawing the sprites from the memory");
+        is_buffered = false;
+    }
+}
+
+void SpriteBatch::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+    for (const auto& run : runs) {
+        states.texture = run.texture;
+        if (is_buffered)
+            target.draw(buffer, run.first, run.count, states);
+        else
+            target.draw(&vertices[run.first], run.count, sf::PrimitiveType::Triangles, states);
+    }
+}
+
+}
@@ -0,0 +1,119 @@
+// Compares evaluating the paw segment curves with tabulated Bernstein bases
+// against evaluating them point by point with pow, as the paw used to
+
+#include <math.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using math::point2d;
+
+namespace
+{
+
+// The generic Bezier curve the paw segments used to be evaluated with,
+// kept here as the baseline
+class BCurve {
+public:
+
+    // constructs a Bezier curve of the specific order
+    BCurve(uint32_t order)
+        : b_coeff(order + 1)
+        , points(order + 1) {
+        for (uint32_t k = 0; k <= order; ++k)
+            b_coeff[k] = math::detail::binomial_coefficient(order, k);
+    }
+
+    // the number of points must be the order of the curve plus one
+    void set_control_points(const point2d* p) {
+        std::copy(p, p + points.size(), points.begin());
+    }
+
+    // evaluates bezier point for a parameter value t, 0 <= t <= 1
+    point2d operator()(double t) const {
+        const size_t n = b_coeff.size() - 1;
+        point2d sum = {0.0, 0.0};
+        for (uint32_t k = 0; k < points.size(); ++k) {
+            const double basis = b_coeff[k] * std::pow(t, k) * std::pow(1.0 - t, n - k);
+            sum.x += basis * points[k].x;
+            sum.y += basis * points[k].y;
+        }
+        return sum;
+    }
+
+private:
+    std::vector<uint64_t> b_coeff;
+    std::vector<point2d> points;
+};
+
+// the paw arc segments are sampled at 6 points
+constexpr std::size_t samples = 6;
+constexpr int iterations = 1000000;
+
+template<std::size_t Order>
+typename math::SampledBCurve<Order, samples>::control_points make_points(int i) {
+    typename math::SampledBCurve<Order, samples>::control_points p;
+    for (std::size_t k = 0; k <= Order; ++k)
+        p[k] = {double(k * 40 + i % 7), double(k * 25 + i % 11)};
+    return p;
+}
+
+template<typename F>
+double measure_ns(F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        f(i);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+// Times both evaluations of a curve of the order, returns false if they disagree
+template<std::size_t Order>
+bool compare(const std::string& name) {
+    using Curve = math::SampledBCurve<Order, samples>;
+    typename Curve::sample_points result;
+    double checksum = 0, max_difference = 0;
+
+    BCurve baseline(Order);
+    const double baseline_ns = measure_ns([&](int i) {
+        const auto p = make_points<Order>(i);
+        baseline.set_control_points(p.data());
+        for (std::size_t s = 0; s <= samples; ++s) {
+            result[s] = baseline(double(s) / samples);
+            checksum += result[s].x;
+        }
+    });
+
+    const double sampled_ns = measure_ns([&](int i) {
+        const auto p = make_points<Order>(i);
+        Curve::evaluate(p, result);
+        checksum -= result[samples / 2].x;
+    });
+
+    for (int i = 0; i < 100; ++i) {
+        const auto p = make_points<Order>(i);
+        baseline.set_control_points(p.data());
+        Curve::evaluate(p, result);
+        for (std::size_t s = 0; s <= samples; ++s) {
+            const point2d expected = baseline(double(s) / samples);
+            max_difference = std::max({max_difference, std::abs(expected.x - result[s].x),
+                                       std::abs(expected.y - result[s].y)});
+        }
+    }
+
+    std::cout << name << ": BCurve " << baseline_ns << " ns, SampledBCurve " << sampled_ns
+              << " ns per curve, speedup " << baseline_ns / sampled_ns
+              << ", largest difference " << max_difference << " (checksum " << checksum << ")" << std::endl;
+    return max_difference < 1e-9;
+}
+
+}
+
+int main() {
+    const bool is_same = compare<2>("quadratic") & compare<3>("cubic");
+    return is_same ? 0 : 1;
+}
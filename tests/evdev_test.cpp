@@ -0,0 +1,115 @@
+// Feeds recorded evdev events through a pipe into the evdev keyboard
+
+#include <header.hpp>
+#include <logger.hpp>
+#include <evdev.hpp>
+extern "C" {
+#include <X11/X.h>
+}
+
+#include <linux/input.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#define KEYCODE(code) ((code) + 8)
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            ++failures; \
+        } \
+    } while (false)
+
+static void write_event(int fd, uint16_t type, uint16_t code, int32_t value) {
+    input_event ie = {};
+    ie.type = type;
+    ie.code = code;
+    ie.value = value;
+    if (write(fd, &ie, sizeof(ie)) != sizeof(ie))
+        std::cerr << "Failed to write an event" << std::endl;
+}
+
+// The events are read on the reader's thread, so the keyboard is updated
+// until the condition holds or a second passes
+static bool wait_until(input::IKeyboard& keyboard, const std::function<bool()>& condition) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (std::chrono::steady_clock::now() < deadline) {
+        keyboard.update();
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+int main() {
+    logger::GlobalLogger::init();
+
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+        std::cerr << "Failed to create a pipe" << std::endl;
+        return 1;
+    }
+    const int device_fd = fds[1];
+
+    auto reader = std::make_unique<input::EvdevReader>(std::vector<int>{fds[0]});
+    input::EvdevReader* device_reader = reader.get();
+    CHECK(device_reader->get_device_count() == 1);
+
+    auto keyboard = input::create_evdev_keyboard_handler(std::move(reader));
+    CHECK(keyboard != nullptr);
+    if (!keyboard)
+        return 1;
+
+    std::vector<input::KeyStroke> presses;
+
+    // a press is reported once, autorepeats keep the key down
+    write_event(device_fd, EV_KEY, KEY_A, 1);
+    write_event(device_fd, EV_KEY, KEY_A, 2);
+    write_event(device_fd, EV_KEY, BTN_LEFT, 1);
+    write_event(device_fd, EV_SYN, SYN_REPORT, 0);
+    CHECK(wait_until(*keyboard, [&] { return keyboard->is_button_pressed(Button1); }));
+    CHECK(keyboard->is_key_pressed(KEYCODE(KEY_A)));
+    keyboard->take_key_presses(presses);
+    CHECK(presses.size() == 1 && presses[0].keycode == KEYCODE(KEY_A));
+
+    write_event(device_fd, EV_KEY, KEY_A, 0);
+    write_event(device_fd, EV_SYN, SYN_REPORT, 0);
+    CHECK(wait_until(*keyboard, [&] { return !keyboard->is_key_pressed(KEYCODE(KEY_A)); }));
+    keyboard->take_key_presses(presses);
+    CHECK(presses.empty());
+
+    // the events after a drop are skipped up to the next report, then the keys
+    // are read from the device, which a pipe can not tell, so none are held
+    write_event(device_fd, EV_KEY, KEY_C, 1);
+    write_event(device_fd, EV_SYN, SYN_REPORT, 0);
+    write_event(device_fd, EV_SYN, SYN_DROPPED, 0);
+    write_event(device_fd, EV_KEY, KEY_B, 1);
+    write_event(device_fd, EV_SYN, SYN_REPORT, 0);
+    write_event(device_fd, EV_KEY, KEY_D, 1);
+    write_event(device_fd, EV_SYN, SYN_REPORT, 0);
+    CHECK(wait_until(*keyboard, [&] { return keyboard->is_key_pressed(KEYCODE(KEY_D)); }));
+    CHECK(!keyboard->is_key_pressed(KEYCODE(KEY_B)));
+    CHECK(!keyboard->is_key_pressed(KEYCODE(KEY_C)));
+    CHECK(!keyboard->is_button_pressed(Button1));
+    keyboard->take_key_presses(presses);
+    CHECK(presses.size() == 2 && presses[0].keycode == KEYCODE(KEY_C) && presses[1].keycode == KEYCODE(KEY_D));
+
+    // an unplugged device is dropped
+    close(device_fd);
+    CHECK(wait_until(*keyboard, [&] { return device_reader->get_device_count() == 0; }));
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+// Checks that moving the paw, and the cat along with it,
+// allocates no memory once it has been built
+
+#include <header.hpp>
+#include <logger.hpp>
+#include <cat.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+static std::atomic<std::size_t> allocation_count{0};
+
+void* operator new(std::size_t size) {
+    ++allocation_count;
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+class TestPaw : public cats::MousePaw
+{
+public:
+    TestPaw() {
+        const data::TextureRegion region;
+        device = std::make_unique<cats::AtlasSprite>(region);
+        left_button = std::make_unique<cats::AtlasSprite>(region);
+        right_button = std::make_unique<cats::AtlasSprite>(region);
+    }
+
+    using MousePaw::init;
+    using MousePaw::update_paw_position;
+    using MousePaw::set_pose_cache_size;
+};
+
+// Moves the paw over the unit square and returns the allocations made meanwhile
+static std::size_t count_move_allocations(TestPaw& paw) {
+    // the first move builds the paw
+    paw.update_paw_position({0.5, 0.5});
+
+    const std::size_t before = allocation_count;
+    const int steps = 16;
+    for (int y = 0; y <= steps; ++y) {
+        for (int x = 0; x <= steps; ++x)
+            paw.update_paw_position({double(x) / steps, double(y) / steps});
+    }
+    return allocation_count - before;
+}
+
+// Writes an image of a single color into the directory, returns its path
+static std::string write_image(const std::filesystem::path& dir, const std::string& name,
+                               sf::Vector2u size, sf::Color color) {
+    const std::filesystem::path path = dir / name;
+    if (!sf::Image(size, color).saveToFile(path))
+        throw std::runtime_error("Cannot write " + path.string());
+    return path.string();
+}
+
+// Moves a cat with a mouse and both buttons over the unit square, pressing
+// and releasing the buttons, and returns the allocations made meanwhile
+static std::size_t count_cat_allocations(const std::filesystem::path& dir) {
+    Json::Value config(Json::objectValue);
+    config["background"] = write_image(dir, "bg.png", {64, 64}, sf::Color::White);
+    config["mouse"]["image"] = write_image(dir, "mouse.png", {16, 16}, sf::Color(0, 0, 0, 128));
+    config["mouse"]["buttons"]["left"] = write_image(dir, "left.png", {8, 16}, sf::Color::Red);
+    config["mouse"]["buttons"]["right"] = write_image(dir, "right.png", {8, 16}, sf::Color::Blue);
+
+    cats::CustomCat cat;
+    if (!cat.init(data::Settings(), config, {{64, 64}, sf::Transform::Identity, 1.0f}))
+        throw std::runtime_error("Failed to initialize the cat");
+
+    auto move = [&cat](input::InputFrame& frame, int steps) {
+        for (int y = 0; y <= steps; ++y) {
+            for (int x = 0; x <= steps; ++x) {
+                frame.mouse_pos = {double(x) / steps, double(y) / steps};
+                frame.is_left_button_pressed = x % 2 == 0;
+                frame.is_right_button_pressed = x % 3 == 0;
+                cat.update(frame);
+                cat.update_mouse(frame);
+            }
+        }
+    };
+
+    // the first moves build the paw and the batches with all the buttons down
+    input::InputFrame frame;
+    move(frame, 6);
+
+    const std::size_t before = allocation_count;
+    move(frame, 16);
+    return allocation_count - before;
+}
+
+int main() {
+    // the vertex buffers of the paw need an OpenGL context, that is a display
+    if (!std::getenv("DISPLAY")) {
+        std::cerr << "No display to create an OpenGL context on, skipping" << std::endl;
+        return 77;
+    }
+
+    logger::GlobalLogger::init();
+
+    int failures = 0;
+    for (std::size_t cache_size : {std::size_t(0), std::size_t(1) << 20}) {
+        TestPaw paw;
+        paw.set_pose_cache_size(cache_size);
+        if (!paw.init(Json::Value(Json::objectValue), Json::Value(Json::objectValue))) {
+            std::cerr << "Failed to initialize the paw" << std::endl;
+            return 1;
+        }
+
+        const std::size_t count = count_move_allocations(paw);
+        if (count != 0) {
+            std::cerr << count << " allocations moving the paw with a pose cache of "
+                      << cache_size << " bytes" << std::endl;
+            ++failures;
+        }
+    }
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "bongo_paw_alloc_test";
+    std::filesystem::create_directories(dir);
+    try {
+        const std::size_t count = count_cat_allocations(dir);
+        if (count != 0) {
+            std::cerr << count << " allocations moving the cat" << std::endl;
+            ++failures;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        ++failures;
+    }
+    std::filesystem::remove_all(dir);
+
+    return failures > 0 ? 1 : 0;
+}